@@ -1,82 +1,113 @@
 #include "../header/ctengine.h"
+#include <math.h>
+#define MAX_EVENTS 32
+// time after which an arrow key which wasn't handled yet is discarded, in nanoseconds
+#define MOVE_TTL_NS 100000000LL
+
+// number of simulation steps per second
+#define TICK_RATE 60
+// speed of the player, in cells per second
+#define PLAYER_SPEED 30.0
+
+/* Defines the state of the game, shared by the update and render callbacks (see EngineCallbacks)
+ * Queue *queue: the Queue
+ * double player_pos[2]: position of the player (row, column) after the last simulation step, not wrapped around
+ * double player_prev[2]: position of the player before the last simulation step
+ * int player_speed[2]: direction the player moves in, along each axis
+ * uint32_t square: glyph id of the UTF-8 character representing the player
+ */
+typedef struct {
+    Queue *queue;
+    double player_pos[2];
+    double player_prev[2];
+    int player_speed[2];
+    uint32_t square;
+} Game;
+
+int update(double dt, void *ctx) {
+    Game *game = ctx;
+
+    // handle key presses
+    Event events[MAX_EVENTS];
+    int count = (int)queue_drain_events(game->queue, events, MAX_EVENTS);
+    for (int e = 0; e < count; ++e) {
+        // the size of the terminal is read when rendering, so resizes need no handling
+        if (events[e].type == EVENT_RESIZE) {
+            continue;
+        }
 
-void* gameloop(void *args) {
-    // get Drawer and Queue
-    Drawer *drawer = args_get_drawer(args);
-    Queue *queue = args_get_queue(args);
+        int val = events[e].value;
 
-    // get terminal size
-    int *size = display_get_size(drawer->display);
-
-    // initialize player position and speed
-    int player_pos[2] = {0, 0};
-    int player_speed[2] = {0, 0};
-
-    // UTF-8 character representing the player
-    const char *square = "■";
-
-    int running = 1;
-
-    // main game loop
-    while (1) {
-        // handle key presses
-        if (!queue_empty(queue)) {
-            int val = queue_get(queue);
-
-            switch (val) {
-                // if 0 is read, exit
-                case 0:
-                    running = 0;
-                    break;
-                // 1 means UP ARROW
-                case 1:
-                    player_speed[0] = -1;
-                    player_speed[1] = 0;
-                    break;
-                // 2 means DOWN ARROW
-                case 2:
-                    player_speed[0] = 1;
-                    player_speed[1] = 0;
-                    break;
-                // 3 means LEFT ARROW
-                case 3:
-                    player_speed[0] = 0;
-                    player_speed[1] = -1;
-                    break;
-                // 4 means RIGHT ARROW
-                case 4:
-                    player_speed[0] = 0;
-                    player_speed[1] = 1;
-                    break;
-                // 5 means SPACEBAR
-                case 5:
-                    player_speed[0] = 0;
-                    player_speed[1] = 0;
-                    break;
-            }
-
-            // if 0 was read, quit
-            if (!running) {
+        switch (val) {
+            // if 0 is read, exit
+            case 0:
+                return 1;
+            // 1 means UP ARROW
+            case 1:
+                game->player_speed[0] = -1;
+                game->player_speed[1] = 0;
+                break;
+            // 2 means DOWN ARROW
+            case 2:
+                game->player_speed[0] = 1;
+                game->player_speed[1] = 0;
+                break;
+            // 3 means LEFT ARROW
+            case 3:
+                game->player_speed[0] = 0;
+                game->player_speed[1] = -1;
+                break;
+            // 4 means RIGHT ARROW
+            case 4:
+                game->player_speed[0] = 0;
+                game->player_speed[1] = 1;
+                break;
+            // 5 means SPACEBAR
+            case 5:
+                game->player_speed[0] = 0;
+                game->player_speed[1] = 0;
                 break;
-            }
-
         }
+    }
+
+    // game logic
+    for (int i = 0; i < 2; ++i) {
+        game->player_prev[i] = game->player_pos[i];
+        game->player_pos[i] += game->player_speed[i] * PLAYER_SPEED * dt;
+    }
 
-        // game logic
-        player_pos[0] += player_speed[0];
-        player_pos[1] += player_speed[1];
+    return 0;
+}
 
-        // clear screen
-        display_clear(drawer->display);
+void render(Display *display, double alpha, void *ctx) {
+    Game *game = ctx;
 
-        // draw player
-        display_set(drawer->display, (player_pos[0] % size[0] + size[0]) % size[0],
-                    (player_pos[1] % size[1] + size[1]) % size[1], square);
+    // get terminal size
+    int rows = display_rows(display);
+    int cols = display_cols(display);
 
-        drawer_draw_display(drawer);
-    }
+    // position of the player between the last two simulation steps
+    int row = (int)floor(game->player_prev[0] + (game->player_pos[0] - game->player_prev[0]) * alpha);
+    int col = (int)floor(game->player_prev[1] + (game->player_pos[1] - game->player_prev[1]) * alpha);
+
+    // clear screen
+    display_clear(display);
+
+    // draw player
+    display_set_id(display, (row % rows + rows) % rows, (col % cols + cols) % cols, game->square);
+}
 
-    free(size);
+void* gameloop(void *args) {
+    // get Drawer and Queue
+    Drawer *drawer = args_get_drawer(args);
+    Queue *queue = args_get_queue(args);
+
+    // initialize the game, with the player still at the top left corner
+    Game game = {queue, {0, 0}, {0, 0}, {0, 0}, display_intern("■")};
+
+    // main game loop: the player moves at the same speed whatever the frame rate
+    EngineCallbacks callbacks = {update, render, &game, TICK_RATE, 0, 0, 0, 0};
+    engine_run(drawer, queue, &callbacks);
 
     return 0;
 }
@@ -92,6 +123,11 @@ int main(void) {
     keylistener_add_key(listener, CONST.K_LARROW, 3);
     keylistener_add_key(listener, CONST.K_RARROW, 4);
     keylistener_add_key(listener, CONST.K_SPACEBAR, 5);
+    // only the last arrow key pressed matters, and only while it is fresh; stopping must never be lost
+    for (int val = 1; val <= 4; ++val) {
+        queue_set_policy(queue, val, QUEUE_POLICY_LATEST, 0, MOVE_TTL_NS);
+    }
+    queue_set_policy(queue, 5, QUEUE_POLICY_NEVER_DROP, 0, 0);
     drawer_set_fps(drawer, 30);
 
     drawer_start_thread(drawer, queue, gameloop);
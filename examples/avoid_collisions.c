@@ -1,7 +1,11 @@
 #include "../header/ctengine.h"
 #include <time.h>
-#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #define ENEMIES 5
+#define MAX_EVENTS 32
+// time after which an arrow key which wasn't handled yet is discarded, in nanoseconds
+#define MOVE_TTL_NS 100000000LL
 
 void* gameloop(void *args) {
     // get Drawer and Queue
@@ -9,38 +13,40 @@ void* gameloop(void *args) {
     Queue *queue = args_get_queue(args);
 
     // get terminal size
-    int *size = display_get_size(drawer->display);
+    int rows = display_rows(drawer->display);
+    int cols = display_cols(drawer->display);
 
     // initialize player position and speed
     int player_pos[2] = {0, 0};
     int player_speed[2] = {0, 0};
 
-    // UTF-8 character representing the player
-    const char *square = "■";
+    // glyph id of the UTF-8 character representing the player
+    const uint32_t square = display_intern("■");
 
-    // initialize enemies
-    int enemy_positions[ENEMIES][2];
-    int enemy_speeds[ENEMIES][2];
+    // glyph id of the UTF-8 character representing enemy
+    const uint32_t enemy = display_intern("☀");
 
-    // randomly decide initial enemy values
+    // initialize enemies, with random positions and speeds (in cells per frame)
+    EntityStore *enemies = init_entities();
     for (int i = 0; i < ENEMIES; ++i) {
-        enemy_positions[i][0] = rand() % size[0];
-        enemy_positions[i][1] = rand() % size[1];
-
-        enemy_speeds[i][0] = rand() % 2;
-        enemy_speeds[i][1] = rand() % 2;
+        float row = (float)rng_range(rows);
+        float col = (float)rng_range(cols);
+        float speed_row = (float)rng_range(2);
+        float speed_col = (float)rng_range(2);
+        entities_add(enemies, row, col, speed_row, speed_col, enemy);
     }
-
-    // UTF-8 character representing enemy
-    const char *enemy = "☀";
+    // enemies by cell, so the player's cell can be checked for collisions directly
+    Grid *grid = init_grid(rows, cols);
 
     int running = 1;
 
     // main game loop
     while (1) {
         // handle key presses
-        if (!queue_empty(queue)) {
-            int val = queue_get(queue);
+        int events[MAX_EVENTS];
+        int count = (int)queue_drain(queue, events, MAX_EVENTS);
+        for (int e = 0; e < count; ++e) {
+            int val = events[e];
 
             switch (val) {
                 // if 0 is read, exit
@@ -72,13 +78,23 @@ void* gameloop(void *args) {
                     player_speed[0] = 0;
                     player_speed[1] = 0;
                     break;
+                    // the terminal was resized, get the new size
+                case RESIZE_EVENT:
+                    rows = display_rows(drawer->display);
+                    cols = display_cols(drawer->display);
+                    grid_resize(grid, rows, cols);
+                    break;
             }
 
-            // if 0 was read, quit
+            // if 0 was read, stop handling key presses
             if (!running) {
                 break;
             }
+        }
 
+        // if 0 was read, quit
+        if (!running) {
+            break;
         }
 
         display_clear(drawer->display);
@@ -88,37 +104,86 @@ void* gameloop(void *args) {
         player_pos[1] += player_speed[1];
 
         // draw player
-        display_set(drawer->display, (player_pos[0] % size[0] + size[0]) % size[0],
-                    (player_pos[1] % size[1] + size[1]) % size[1], square);
-
-        // draw enemies
-        for (int i = 0; i < ENEMIES; ++i) {
-            if (player_pos[0] == enemy_positions[i][0] && player_pos[1] == enemy_positions[i][1]) {
-                queue->finished = 1;
-                drawer_set_exit_msg(drawer, "You lose!");
-                return 0;
-            }
-
-            enemy_positions[i][0] += enemy_speeds[i][0];
-            enemy_positions[i][1] += enemy_speeds[i][1];
-
-            display_set(drawer->display, (enemy_positions[i][0] % size[0] + size[0]) % size[0],
-                        (enemy_positions[i][1] % size[1] + size[1]) % size[1], enemy);
+        int player_row = (player_pos[0] % rows + rows) % rows;
+        int player_col = (player_pos[1] % cols + cols) % cols;
+        display_set_id(drawer->display, player_row, player_col, square);
+
+        // check for collisions with enemies
+        EntityHandle hit;
+        grid_update(grid, enemies);
+        if (grid_query_point(grid, player_row, player_col, &hit, 1)) {
+            delete_grid(grid);
+            delete_entities(enemies);
+            queue_finish(queue);
+            drawer_set_exit_msg(drawer, "You lose!");
+            return 0;
         }
 
+        // move enemies by a frame, wrapping around the screen, and draw them
+        entities_integrate(enemies, 1, rows, cols);
+        entities_render(enemies, drawer->display);
+
         drawer_draw_display(drawer);
     }
 
-    free(size);
-
+    delete_grid(grid);
+    delete_entities(enemies);
     return 0;
 }
 
-int main(void) {
-    srand(time(NULL));
+/* Plays the game, replays a recording of it, or plays and records it to a file
+ * Usage: avoid_collisions [--record FILE | --replay FILE [--fast]]
+ */
+int main(int argc, char **argv) {
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    int replay_mode = REPLAY_REALTIME;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            record_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replay_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--fast")) {
+            replay_mode = REPLAY_FAST;
+        }
+        else {
+            printf("Usage: %s [--record FILE | --replay FILE [--fast]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    rng_seed(time(NULL));
 
     Queue *queue = init_queue();
     Drawer *drawer = init_drawer();
+    // only the last arrow key pressed matters, and only while it is fresh; stopping must never be lost
+    for (int val = 1; val <= 4; ++val) {
+        queue_set_policy(queue, val, QUEUE_POLICY_LATEST, 0, MOVE_TTL_NS);
+    }
+    queue_set_policy(queue, 5, QUEUE_POLICY_NEVER_DROP, 0, 0);
+    drawer_set_fps(drawer, 30);
+
+    // replay a recording, without a terminal; the frames are kept in memory, so two replays can be compared
+    if (replay_path != NULL) {
+        Backend *backend = init_memory_backend(1);
+        drawer_set_backend(drawer, backend);
+        Replay *replay = init_replay(replay_path, drawer, queue, replay_mode);
+        if (replay == NULL) {
+            printf("Couldn't replay %s\n", replay_path);
+            return 1;
+        }
+        drawer_start_thread(drawer, queue, gameloop);
+        replay_run(replay);
+        printf("Replayed %lu events in %lu frames in %.3f s\n", replay->events, replay->frame,
+               (double)replay->elapsed_ns / 1e9);
+        printf("Checksum of %lu frames: %016llx\n", backend->frames, (unsigned long long)backend->checksum);
+        delete_replay(replay);
+        delete_backend(backend);
+        return 0;
+    }
+
     KeyListener *listener = init_keylistener(queue, drawer);
 
     keylistener_add_key(listener, CONST.K_ESC, 0);
@@ -127,10 +192,22 @@ int main(void) {
     keylistener_add_key(listener, CONST.K_LARROW, 3);
     keylistener_add_key(listener, CONST.K_RARROW, 4);
     keylistener_add_key(listener, CONST.K_SPACEBAR, 5);
-    drawer_set_fps(drawer, 30);
+
+    Recorder *recorder = NULL;
+    if (record_path != NULL) {
+        recorder = init_recorder(record_path, drawer, queue);
+        if (recorder == NULL) {
+            printf("Couldn't record to %s\n", record_path);
+        }
+    }
 
     drawer_start_thread(drawer, queue, gameloop);
     keylistener_handle_in(listener);
 
+    if (recorder != NULL) {
+        printf("Recorded %lu events in %lu frames\n", recorder->events, recorder->frame);
+        delete_recorder(recorder);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,190 @@
+#include "../header/cells.h"
+#include "../header/display.h"
+#include <stdio.h>
+#include <string.h>
+#define CASES 5000
+#define MAX_ROWS 24
+#define MAX_COLUMNS 70
+// how far rectangles may start outside the Display, so that they cross its edges
+#define MARGIN 9
+// glyph ids drawn are picked from 1 to IDS, so that the transparent key of a blit appears often
+#define IDS 4
+#define MAX_BUFFER ((MAX_ROWS + 2 * MARGIN) * (MAX_COLUMNS + 2 * MARGIN))
+
+/* Test of the bulk drawing operations of Display and of the cell kernels behind them
+ * Each version of the kernels (AVX2, SSE2 and scalar, see cells_set_kernels) draws CASES random rectangles crossing the
+ *  edges of Displays of random sizes, with display_fill_rect, display_hline, display_vline, display_blit (with and
+ *  without a transparent key) and display_fill_style; the same shapes are drawn cell by cell with display_set_id and
+ *  display_set_style on a second Display, and both Displays must end up with the same cells, styles and dirty ranges
+ * cells_blit_styled, which is only used by the Compositor, is compared with a plain loop directly
+ * Exits with 1 on any mismatch
+ */
+
+static const char *kernel_names[] = {"auto", "avx2", "sse2", "scalar"};
+
+// state of the xorshift generator picking the random cases; reset for each version of the kernels
+static uint32_t random_state;
+
+// returns the next pseudo-random 32-bit value
+static uint32_t random_next() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// returns a pseudo-random integer from 0 to n - 1
+static int random_range(int n) {
+    return (int)(random_next() % (uint32_t)n);
+}
+
+// compares the cells, styles and dirty ranges of two Displays of the same size
+static int same_display(const Display *a, const Display *b) {
+    size_t cells = (size_t)a->_rows * a->_columns;
+    if (memcmp(a->_display_array, b->_display_array, cells * sizeof(uint32_t)) ||
+        memcmp(a->_style_array, b->_style_array, cells * sizeof(uint32_t)) ||
+        memcmp(a->_dirty_rows, b->_dirty_rows, DIRTY_WORDS(a->_rows) * sizeof(uint64_t))) {
+        return 0;
+    }
+    for (int row = 0; row < a->_rows; ++row) {
+        if (display_row_dirty(a, row) &&
+            (a->_dirty_start[row] != b->_dirty_start[row] || a->_dirty_end[row] != b->_dirty_end[row])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// reference version of the bulk operations: sets the cells of the rectangle within the Display one by one
+// transparent cells are set to the value they already hold, since the bulk operations mark the whole rectangle dirty
+static void set_rect(Display *display, int row, int column, int height, int width, const uint32_t *cells,
+                     uint32_t transparent, int style) {
+    for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+            int r = row + i;
+            int c = column + j;
+            uint32_t value = cells[i * width + j];
+            if (r < 0 || r >= display->_rows || c < 0 || c >= display->_columns) {
+                continue;
+            }
+            if (value == transparent) {
+                value = display->_display_array[r*display->_columns + c];
+            }
+            if (style) {
+                display_set_style(display, r, c, value);
+            }
+            else {
+                display_set_id(display, r, c, value);
+            }
+        }
+    }
+}
+
+// draws a random shape on both Displays, with the bulk operation on test and cell by cell on reference
+static void draw_random(Display *test, Display *reference, uint32_t *buffer) {
+    int op = random_range(6);
+    int row = random_range(test->_rows + 2 * MARGIN) - MARGIN;
+    int column = random_range(test->_columns + 2 * MARGIN) - MARGIN;
+    int height = op == 1 ? 1 : random_range(test->_rows + MARGIN + 1);
+    int width = op == 2 ? 1 : random_range(test->_columns + MARGIN + 1);
+    uint32_t id = 1 + (uint32_t)random_range(IDS);
+    uint32_t transparent = op == 4 ? 1 + (uint32_t)random_range(IDS) : GLYPH_NONE;
+    for (int i = 0; i < height * width; ++i) {
+        buffer[i] = op >= 3 && op <= 4 ? 1 + (uint32_t)random_range(IDS) : id;
+    }
+
+    switch (op) {
+        case 0:
+            display_fill_rect(test, row, column, height, width, id);
+            break;
+        case 1:
+            display_hline(test, row, column, width, id);
+            break;
+        case 2:
+            display_vline(test, row, column, height, id);
+            break;
+        case 3:
+        case 4:
+            display_blit(test, row, column, height, width, buffer, transparent);
+            break;
+        default:
+            display_fill_style(test, row, column, height, width, id);
+    }
+    set_rect(reference, row, column, height, width, buffer, transparent, op == 5);
+}
+
+// runs CASES random cases with the current version of the kernels; returns the number of mismatches
+static int run_display(Display *test, Display *reference) {
+    static uint32_t buffer[MAX_BUFFER];
+    int mismatches = 0;
+    for (int n = 0; n < CASES; ++n) {
+        int rows = 1 + random_range(MAX_ROWS);
+        int columns = 1 + random_range(MAX_COLUMNS);
+        display_resize(test, rows, columns);
+        display_resize(reference, rows, columns);
+        display_clear(test);
+        display_clear(reference);
+        // a few shapes on top of each other, so blits have something to show through their transparent cells
+        int shapes = 1 + random_range(4);
+        for (int i = 0; i < shapes; ++i) {
+            draw_random(test, reference, buffer);
+        }
+        if (!same_display(test, reference)) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+// compares cells_blit_styled with a plain loop, on runs of every length and offset; returns the number of mismatches
+static int run_blit_styled() {
+    uint32_t src[80], src_style[80], dst[80], dst_style[80], ref[80], ref_style[80];
+    int mismatches = 0;
+    for (int count = 0; count <= 64; ++count) {
+        for (int offset = 0; offset < 8; ++offset) {
+            for (int i = 0; i < 80; ++i) {
+                src[i] = 1 + (uint32_t)random_range(IDS);
+                src_style[i] = random_next();
+                dst[i] = ref[i] = random_next();
+                dst_style[i] = ref_style[i] = random_next();
+            }
+            uint32_t key = 1 + (uint32_t)random_range(IDS);
+            cells_blit_styled(&dst[offset], &dst_style[offset], &src[offset], &src_style[offset], count, key);
+            for (int i = offset; i < offset + count; ++i) {
+                if (src[i] != key) {
+                    ref[i] = src[i];
+                    ref_style[i] = src_style[i];
+                }
+            }
+            if (memcmp(dst, ref, sizeof(dst)) || memcmp(dst_style, ref_style, sizeof(dst_style))) {
+                ++mismatches;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    Display *test = init_display();
+    Display *reference = init_display();
+    int failed = 0;
+    for (int kernels = CELLS_AVX2; kernels <= CELLS_SCALAR; ++kernels) {
+        if (cells_set_kernels(kernels)) {
+            printf("%-6s  not supported, skipped\n", kernel_names[kernels]);
+            continue;
+        }
+        random_state = 1;
+        int display_mismatches = run_display(test, reference);
+        int styled_mismatches = run_blit_styled();
+        printf("%-6s  %d display cases: %d mismatches, cells_blit_styled: %d mismatches\n", kernel_names[kernels],
+               CASES, display_mismatches, styled_mismatches);
+        if (display_mismatches || styled_mismatches) {
+            failed = 1;
+        }
+    }
+    cells_set_kernels(CELLS_AUTO);
+    delete_display(test);
+    delete_display(reference);
+    printf("%s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
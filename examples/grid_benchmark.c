@@ -0,0 +1,100 @@
+#include "../header/grid.h"
+#include "../header/queue.h"
+#include "../header/rng.h"
+#include <stdio.h>
+#define WORLD_ROWS 1000
+#define WORLD_COLUMNS 1000
+#define FRAMES 100
+// largest number of entities the linear scan is measured with, since its cost grows with the square of the number
+#define MAX_SCAN_ENTITIES 10000
+#define MAX_FOUND 256
+
+/* Scaling benchmark of the Grid
+ * For each number of entities, from 10 to 100k, entities moving in random directions over a WORLD_ROWS x WORLD_COLUMNS
+ *  world are integrated for FRAMES frames; on each frame, the Grid is updated, every colliding pair is found, and every
+ *  entity queries the entities around it, as a game would; the colliding pairs are also found by comparing every pair
+ *  of entities, as the examples used to do, for comparison
+ */
+
+static void count_pair(EntityHandle a, EntityHandle b, void *ctx) {
+    (void)a;
+    (void)b;
+    ++*(size_t *)ctx;
+}
+
+// colliding pairs found by comparing every pair of entities
+static size_t scan_pairs(const EntityStore *entities) {
+    size_t pairs = 0;
+    for (int i = 0; i < entities->count; ++i) {
+        int row = (int)entities->pos_row[i];
+        int column = (int)entities->pos_col[i];
+        for (int j = i + 1; j < entities->count; ++j) {
+            if ((int)entities->pos_row[j] == row && (int)entities->pos_col[j] == column) {
+                ++pairs;
+            }
+        }
+    }
+    return pairs;
+}
+
+static void run(int count) {
+    EntityStore *entities = init_entities();
+    for (int i = 0; i < count; ++i) {
+        entities_add(entities, (float)rng_range(WORLD_ROWS), (float)rng_range(WORLD_COLUMNS),
+                     (float)(rng_range(201) - 100) / 100, (float)(rng_range(201) - 100) / 100, 'o');
+    }
+    Grid *grid = init_grid(WORLD_ROWS, WORLD_COLUMNS);
+    EntityHandle found[MAX_FOUND];
+
+    long long update_ns = 0, pairs_ns = 0, query_ns = 0, scan_ns = 0;
+    unsigned long moved = 0;
+    size_t pairs = 0, scanned = 0, hits = 0;
+    for (int frame = 0; frame < FRAMES; ++frame) {
+        entities_integrate(entities, 1, WORLD_ROWS, WORLD_COLUMNS);
+
+        long long start = get_monotonic_ns();
+        grid_update(grid, entities);
+        long long updated = get_monotonic_ns();
+        size_t frame_pairs = 0;
+        grid_for_each_pair(grid, count_pair, &frame_pairs);
+        long long paired = get_monotonic_ns();
+        for (int i = 0; i < entities->count; ++i) {
+            hits += grid_query_radius(grid, (int)entities->pos_row[i], (int)entities->pos_col[i], 2, found, MAX_FOUND);
+        }
+        long long queried = get_monotonic_ns();
+        update_ns += updated - start;
+        pairs_ns += paired - updated;
+        query_ns += queried - paired;
+        moved += grid->moved;
+        pairs += frame_pairs;
+
+        if (count <= MAX_SCAN_ENTITIES) {
+            start = get_monotonic_ns();
+            scanned += scan_pairs(entities);
+            scan_ns += get_monotonic_ns() - start;
+        }
+    }
+
+    printf("%7d  %10.1f  %9.1f%%  %10.1f  %10.1f  %8.2f  ", count, update_ns / (double)FRAMES / 1e3,
+           100.0 * moved / ((double)count * FRAMES), pairs_ns / (double)FRAMES / 1e3,
+           query_ns / (double)FRAMES / 1e3, pairs / (double)FRAMES);
+    if (count <= MAX_SCAN_ENTITIES) {
+        printf("%12.1f  %s\n", scan_ns / (double)FRAMES / 1e3, scanned == pairs ? "ok" : "MISMATCH");
+    }
+    else {
+        printf("%12s\n", "-");
+    }
+
+    delete_grid(grid);
+    delete_entities(entities);
+}
+
+int main() {
+    rng_seed(1);
+    printf("%7s  %10s  %10s  %10s  %10s  %8s  %12s\n", "count", "update us", "moved", "pairs us", "radius us",
+           "pairs", "scan us");
+    for (int count = 10; count <= 100000; count *= 10) {
+        run(count);
+    }
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "../header/keylistener.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+// maximum number of events recorded by the game loop
+#define MAX_EVENTS 64
+// number of repeats sent after the first one, as a terminal would while the key is held down
+#define REPEATS 10
+// delay between the press of the key and its first repeat, in nanoseconds; a common terminal repeat delay
+#define REPEAT_DELAY_NS 400000000LL
+// interval between the following repeats, in nanoseconds; a common terminal repeat rate
+#define REPEAT_INTERVAL_NS 30000000LL
+// pause after the last repeat, longer than the press hold time, after which the key is pressed again
+#define PAUSE_NS 600000000LL
+// capacity of the Queue of the quit case, which the keys sent fill up since the game loop never reads it
+#define QUIT_CAPACITY 16
+// time after which the game loop of the quit case gives up waiting for the request to quit, in nanoseconds
+#define QUIT_TIMEOUT_NS 2000000000LL
+
+/* Test of the key repeats seen by the game through the KeyListener
+ * The bytes a terminal sends while a key is held down are written to a pipe read by the KeyListener in place of stdin:
+ *  the press, its first repeat REPEAT_DELAY_NS later, REPEATS more repeats every REPEAT_INTERVAL_NS, then a new press
+ *  PAUSE_NS later, and finally CTRL+C
+ * The game loop records every event it reads along with the state of the action at that point (see InputState); the
+ *  press must be an EVENT_KEY, every repeat (including the first one) an EVENT_KEY_REPEAT of a held action which
+ *  keeps the time of the press, and the new press an EVENT_KEY again
+ * In the quit case, the game loop only queries the InputState and never reads the Queue, which the keys sent fill up
+ *  before CTRL+C; the game loop must still be asked to quit (see input_quit_requested), so the KeyListener exits
+ * Exits with 1 if any case fails
+ */
+
+/* An event read by the game loop
+ * Event event: the event
+ * int held: whether the action of the event was held (see input_is_held) when the event was read
+ * long long press_ns: time of the last press of the action (see input_press_ns) when the event was read
+ */
+typedef struct {
+    Event event;
+    int held;
+    long long press_ns;
+} Record;
+
+static KeyListener *key_listener;
+static Record records[MAX_EVENTS];
+static int record_count = 0;
+// set by the game loop of the quit case if it was asked to quit before QUIT_TIMEOUT_NS passed
+static int quit_requested = 0;
+
+/* Game loop recording the events it reads until EVENT_QUIT
+ */
+static void *run_game(void *args) {
+    Queue *queue = args_get_queue(args);
+    Event events[MAX_EVENTS];
+    while (queue_wait_until(queue, -1)) {
+        size_t count = queue_drain_events(queue, events, MAX_EVENTS);
+        for (size_t i = 0; i < count && record_count < MAX_EVENTS; ++i) {
+            Record *record = &records[record_count++];
+            record->event = events[i];
+            record->held = input_is_held(key_listener->input, events[i].value);
+            record->press_ns = input_press_ns(key_listener->input, events[i].value);
+            if (events[i].type == EVENT_QUIT) {
+                return NULL;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Game loop of the quit case, which only queries the InputState, until it is asked to quit or QUIT_TIMEOUT_NS pass
+ */
+static void *run_input_game(void *args) {
+    long long deadline = get_monotonic_ns() + QUIT_TIMEOUT_NS;
+    while (get_monotonic_ns() < deadline) {
+        if (input_quit_requested(key_listener->input)) {
+            quit_requested = 1;
+            return NULL;
+        }
+        sleep_until_ns(get_monotonic_ns() + REPEAT_INTERVAL_NS);
+    }
+    return NULL;
+}
+
+/* Writes the keys of the repeat case to the pipe read by the KeyListener, at the times a terminal would send them
+ */
+static void *run_terminal(void *args) {
+    int fd = *(int *)args;
+    long long now = get_monotonic_ns();
+    write(fd, "a", 1);
+    now += REPEAT_DELAY_NS;
+    for (int i = 0; i <= REPEATS; ++i) {
+        sleep_until_ns(now);
+        write(fd, "a", 1);
+        now += REPEAT_INTERVAL_NS;
+    }
+    sleep_until_ns(now - REPEAT_INTERVAL_NS + PAUSE_NS);
+    write(fd, "a", 1);
+    sleep_until_ns(get_monotonic_ns() + REPEAT_INTERVAL_NS);
+    write(fd, "\x03", 1);
+    return NULL;
+}
+
+/* Writes the keys of the quit case to the pipe read by the KeyListener: more presses than the Queue can hold, then
+ *  CTRL+C
+ */
+static void *run_quit_terminal(void *args) {
+    int fd = *(int *)args;
+    for (int i = 0; i < 2 * QUIT_CAPACITY; ++i) {
+        write(fd, i % 2 ? "a" : "b", 1);
+        sleep_until_ns(get_monotonic_ns() + REPEAT_INTERVAL_NS / 10);
+    }
+    write(fd, "\x03", 1);
+    return NULL;
+}
+
+/* Runs a KeyListener reading from a pipe instead of stdin until it exits, along with a game loop and a thread writing
+ *  to the pipe as a terminal would
+ */
+static void run_keylistener(Queue *queue, void *(*game)(void *args), void *(*terminal)(void *args)) {
+    int fds[2];
+    pipe(fds);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+
+    Drawer *drawer = init_drawer();
+    Backend *backend = init_null_backend();
+    drawer_set_backend(drawer, backend);
+    drawer_set_size(drawer, 1, 1);
+    key_listener = init_keylistener(queue, drawer);
+    keylistener_add_key(key_listener, CONST.K_a, 1);
+    keylistener_add_key(key_listener, CONST.K_b, 2);
+
+    pthread_t terminal_id;
+    pthread_create(&terminal_id, NULL, terminal, &fds[1]);
+    drawer_start_thread(drawer, queue, game);
+    keylistener_handle_in(key_listener);
+    pthread_join(terminal_id, NULL);
+    delete_backend(backend);
+    close(fds[1]);
+}
+
+/* Checks a recorded event
+ * Return: 1 if it has the expected type and action state, else 0
+ */
+static int check(int i, int type, int held, long long press_ns) {
+    const char *names[] = {"EVENT_NONE", "EVENT_KEY", "EVENT_KEY_REPEAT", "EVENT_RESIZE", "EVENT_QUIT"};
+    if (i >= record_count) {
+        printf("FAILED  event %d: missing, expected %s\n", i, names[type]);
+        return 0;
+    }
+    const Record *record = &records[i];
+    if (record->event.type != type || (type != EVENT_QUIT && (record->held != held || record->press_ns != press_ns))) {
+        printf("FAILED  event %d: %s, held %d, pressed at %lld; expected %s, held %d, pressed at %lld\n", i,
+               names[record->event.type], record->held, record->press_ns, names[type], held, press_ns);
+        return 0;
+    }
+    return 1;
+}
+
+int main() {
+    // repeat case; every repeat is kept, so the game loop reads all of them
+    Queue *queue = init_queue();
+    queue_set_policy(queue, 1, QUEUE_POLICY_NEVER_DROP, 0, 0);
+    run_keylistener(queue, run_game, run_terminal);
+
+    int passed = check(0, EVENT_KEY, 0, records[0].event.time_ns);
+    for (int i = 1; i <= REPEATS + 1; ++i) {
+        passed &= check(i, EVENT_KEY_REPEAT, 1, records[0].event.time_ns);
+    }
+    passed &= check(REPEATS + 2, EVENT_KEY, 0, records[REPEATS + 2].event.time_ns);
+    passed &= check(REPEATS + 3, EVENT_QUIT, 0, 0);
+    printf("%s  key repeats (%d events read)\n", passed ? "ok    " : "FAILED", record_count);
+
+    // quit case; the Queue and the InputState are deleted along with the KeyListener once it exits
+    run_keylistener(init_queue_capacity(QUIT_CAPACITY, QUEUE_OVERFLOW_DROP), run_input_game, run_quit_terminal);
+    printf("%s  quit requested to a game loop which doesn't read the Queue\n", quit_requested ? "ok    " : "FAILED");
+    passed &= quit_requested;
+
+    printf("%s\n", passed ? "ok" : "FAILED");
+    return !passed;
+}
@@ -0,0 +1,96 @@
+#include "../header/jobs.h"
+#include <stdio.h>
+#include <unistd.h>
+// number of worker threads of the JobSystem
+#define WORKERS 3
+// number of threads which aren't workers submitting jobs at the same time as the owner thread
+#define SUBMITTERS 3
+// number of rounds each submitting thread runs
+#define ROUNDS 2000
+// number of jobs submitted per round, each depending on the previous one every other job
+#define ROUND_JOBS 16
+// size of the range of the jobs_parallel_for call of each round
+#define RANGE 64
+// time after which the test is considered stuck and killed, in seconds
+#define TIMEOUT_S 60
+
+/* Test of the JobSystem
+ * The worker threads must not be started before the first job is submitted
+ * Then the owner thread and SUBMITTERS other threads submit jobs and parallel ranges at the same time, for ROUNDS rounds
+ *  each, and wait for them: the jobs of the other threads go through the injection queue, while those of the owner go to
+ *  its own deque, and every job must run exactly once
+ * Exits with 1 if any check fails, and is killed after TIMEOUT_S seconds if a job is lost
+ */
+
+static JobSystem *jobs;
+// number of jobs run, and of indices of parallel ranges visited
+static atomic_long jobs_run = 0;
+static atomic_long indices_run = 0;
+
+static void count_job(void *ctx) {
+    (void)ctx;
+    atomic_fetch_add_explicit(&jobs_run, 1, memory_order_relaxed);
+}
+
+static void count_range(size_t begin, size_t end, void *ctx) {
+    (void)ctx;
+    atomic_fetch_add_explicit(&indices_run, (long)(end - begin), memory_order_relaxed);
+}
+
+/* Runs ROUNDS rounds of jobs and parallel ranges on the calling thread
+ */
+static void *run_submitter(void *args) {
+    (void)args;
+    Job round[ROUND_JOBS];
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (int i = 0; i < ROUND_JOBS; ++i) {
+            job_init(&round[i], count_job, NULL);
+            if (i % 2) {
+                job_depends_on(&round[i], &round[i - 1]);
+            }
+            jobs_submit(jobs, &round[i]);
+        }
+        for (int i = 0; i < ROUND_JOBS; ++i) {
+            jobs_wait(jobs, &round[i]);
+        }
+        jobs_parallel_for(jobs, 0, RANGE, 1, count_range, NULL);
+    }
+    return NULL;
+}
+
+/* Prints the result of a check
+ * Return: 1 if the check passed, else 0
+ */
+static int report(const char *name, int passed) {
+    printf("%s  %s\n", passed ? "ok    " : "FAILED", name);
+    return passed;
+}
+
+int main() {
+    alarm(TIMEOUT_S);
+    int passed = 1;
+
+    jobs = init_jobs(WORKERS);
+    passed &= report("no worker started before the first job", !atomic_load(&jobs->_started));
+
+    pthread_t threads[SUBMITTERS];
+    for (int i = 0; i < SUBMITTERS; ++i) {
+        pthread_create(&threads[i], NULL, run_submitter, NULL);
+    }
+    run_submitter(NULL);
+    for (int i = 0; i < SUBMITTERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    passed &= report("workers started by the first job", atomic_load(&jobs->_started));
+
+    long expected_jobs = (long)(SUBMITTERS + 1) * ROUNDS * ROUND_JOBS;
+    long expected_indices = (long)(SUBMITTERS + 1) * ROUNDS * RANGE;
+    printf("        %ld of %ld jobs run, %ld of %ld indices visited\n", atomic_load(&jobs_run), expected_jobs,
+           atomic_load(&indices_run), expected_indices);
+    passed &= report("jobs submitted by the owner and other threads at once",
+                     atomic_load(&jobs_run) == expected_jobs && atomic_load(&indices_run) == expected_indices);
+    delete_jobs(jobs);
+
+    printf("%s\n", passed ? "ok" : "FAILED");
+    return !passed;
+}
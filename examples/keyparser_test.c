@@ -0,0 +1,148 @@
+#include "../header/keyparser.h"
+#include <stdio.h>
+#include <string.h>
+// maximum number of steps of a test case
+#define MAX_STEPS 4
+// size of the text describing the keys reported during a test case
+#define OUTPUT_SIZE 256
+
+/* Test of the KeyParser
+ * Each case feeds fixed bytes to a KeyParser, possibly flushing it at given times, and compares the keys reported with
+ *  the expected ones; every case is run twice, once with each step's bytes fed at once and once fed one byte per call,
+ *  as if every byte arrived in its own read
+ * Keys are described as their bytes, with ESC written as "ESC" and other bytes outside printable ASCII in hexadecimal
+ *  ("<c3>"), followed by "+S", "+A" and "+C" for MOD_SHIFT, MOD_ALT and MOD_CTRL; keys are separated by spaces
+ * Exits with 1 if any case fails
+ */
+
+/* A step of a test case
+ * const char *bytes: bytes fed to the KeyParser, or NULL to flush it instead
+ * long long now: time at which the bytes are read, or at which the KeyParser is flushed
+ */
+typedef struct {
+    const char *bytes;
+    long long now;
+} Step;
+
+/* A test case
+ * const char *name: description of the case
+ * Step steps[MAX_STEPS]: steps run in order, followed by END if there are fewer than MAX_STEPS
+ * const char *expected: description of the keys which must be reported
+ */
+typedef struct {
+    const char *name;
+    Step steps[MAX_STEPS];
+    const char *expected;
+} TestCase;
+
+// unused steps
+#define END {NULL, -1}
+
+static const TestCase cases[] = {
+    {"plain keys", {{"aZ1 ", 0}, END}, "a Z+S 1 <20>"},
+    {"control keys", {{"\x01\t\n\x7f", 0}, END}, "<01>+C <09> <0a> <7f>"},
+    {"csi and ss3 keys", {{"\x1b[A\x1b[15~\x1bOP\x1b[H", 0}, END}, "ESC[A ESC[15~ ESCOP ESC[H"},
+    {"paste mixing plain, csi and ss3 keys", {{"a\x1b[Ab\x1bOQc\x1b[3~d", 0}, END},
+     "a ESC[A b ESCOQ c ESC[3~ d"},
+    {"ctrl modifier", {{"\x1b[1;5A", 0}, END}, "ESC[A+C"},
+    {"shift modifier on a '~' sequence", {{"\x1b[15;2~", 0}, END}, "ESC[15~+S"},
+    {"shift modifier on an ss3 sequence", {{"\x1bO2P", 0}, END}, "ESCOP+S"},
+    {"combined modifiers", {{"\x1b[1;8D\x1b[3;3~", 0}, END}, "ESC[D+S+A+C ESC[3~+A"},
+    {"alt key", {{"\x1bx\x1bX", 0}, END}, "x+A X+S+A"},
+    {"esc esc", {{"\x1b\x1b", 0}, {NULL, ESC_TIMEOUT_NS - 1}, {NULL, ESC_TIMEOUT_NS}, END}, "ESC ESC"},
+    {"esc esc starting a sequence", {{"\x1b\x1b[B", 0}, END}, "ESC ESC[B"},
+    {"lone esc completed before the timeout",
+     {{"\x1b", 0}, {NULL, ESC_TIMEOUT_NS - 1}, {"[A", ESC_TIMEOUT_NS - 1}, END}, "ESC[A"},
+    {"lone esc flushed after the timeout", {{"\x1b", 0}, {NULL, ESC_TIMEOUT_NS}, {"[A", ESC_TIMEOUT_NS}, END},
+     "ESC [ A+S"},
+    {"esc and '[' flushed after the timeout", {{"\x1b[", 0}, {NULL, ESC_TIMEOUT_NS}, {"A", ESC_TIMEOUT_NS}, END},
+     "[+A A+S"},
+    {"lone esc followed by a key after the timeout, without a flush", {{"\x1b", 0}, {"a", ESC_TIMEOUT_NS}, END},
+     "ESC a"},
+    {"esc and '[' followed by a key after the timeout, without a flush", {{"\x1b[", 0}, {"A", ESC_TIMEOUT_NS}, END},
+     "[+A A+S"},
+    {"flush without a pending key", {{"a", 0}, {NULL, ESC_TIMEOUT_NS}, END}, "a"},
+    {"csi longer than a key", {{"\x1b[200~a", 0}, END}, "a"},
+    {"csi longer than the sequence buffer", {{"\x1b[1;2;3;4;5;6;7;8;9;10Hb", 0}, END}, "b"},
+    {"unterminated csi flushed after the timeout", {{"\x1b[12", 0}, {NULL, ESC_TIMEOUT_NS}, {"c", ESC_TIMEOUT_NS}, END},
+     "c"},
+    {"csi cut off by a new escape sequence", {{"\x1b[1\x1b[B", 0}, END}, "ESC[B"},
+    {"csi cut off by a lone esc", {{"\x1b[1\x1b", 0}, {NULL, ESC_TIMEOUT_NS}, END}, "ESC"},
+    {"ss3 cut off by a plain key", {{"\x1bO\x01", 0}, END}, "<01>+C"},
+    {"utf-8 characters", {{"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", 0}, END}, "<c3><a9> <e2><82><ac> <f0><9f><98><80>"},
+    {"invalid utf-8 bytes", {{"\x80" "a\xc0" "b\xff" "c", 0}, END}, "a b c"},
+    {"truncated utf-8 cut off by a plain key", {{"\xe2\x82" "a", 0}, END}, "a"},
+    {"truncated utf-8 cut off by an escape sequence", {{"\xc3\x1b[A", 0}, END}, "ESC[A"},
+    {"truncated utf-8 flushed after the timeout", {{"\xf0\x9f", 0}, {NULL, ESC_TIMEOUT_NS}, {"d", ESC_TIMEOUT_NS}, END},
+     "d"},
+};
+
+/* Appends the description of a reported key to the output of the case being run (see the description of keys above)
+ */
+static void describe_key(const char key[KEYSIZE], uint16_t modifiers, void *ctx) {
+    char *output = ctx;
+    size_t length = strlen(output);
+    if (length > 0) {
+        length += snprintf(output + length, OUTPUT_SIZE - length, " ");
+    }
+    for (int i = 0; i < KEYSIZE && key[i]; ++i) {
+        unsigned char byte = (unsigned char)key[i];
+        if (byte == 0x1b) {
+            length += snprintf(output + length, OUTPUT_SIZE - length, "ESC");
+        }
+        else if (byte <= 0x20 || byte >= 0x7f) {
+            length += snprintf(output + length, OUTPUT_SIZE - length, "<%02x>", byte);
+        }
+        else {
+            length += snprintf(output + length, OUTPUT_SIZE - length, "%c", byte);
+        }
+    }
+    snprintf(output + length, OUTPUT_SIZE - length, "%s%s%s", modifiers & MOD_SHIFT ? "+S" : "",
+             modifiers & MOD_ALT ? "+A" : "", modifiers & MOD_CTRL ? "+C" : "");
+}
+
+/* Runs a test case, feeding each step's bytes at once or one byte per call
+ * Return: 1 if the keys reported are the expected ones, else 0
+ */
+static int run_case(const TestCase *test, int bytewise) {
+    char output[OUTPUT_SIZE] = "";
+    KeyParser *parser = init_keyparser();
+    for (int i = 0; i < MAX_STEPS && test->steps[i].now >= 0; ++i) {
+        const Step *step = &test->steps[i];
+        if (step->bytes == NULL) {
+            keyparser_flush(parser, step->now, describe_key, output);
+        }
+        else if (bytewise) {
+            for (size_t j = 0; step->bytes[j]; ++j) {
+                keyparser_feed(parser, &step->bytes[j], 1, step->now, describe_key, output);
+            }
+        }
+        else {
+            keyparser_feed(parser, step->bytes, strlen(step->bytes), step->now, describe_key, output);
+        }
+    }
+    delete_keyparser(parser);
+    if (strcmp(output, test->expected) != 0) {
+        printf("FAILED  %s%s\n        expected: %s\n        got:      %s\n", test->name,
+               bytewise ? " (one byte per read)" : "", test->expected, output);
+        return 0;
+    }
+    return 1;
+}
+
+int main() {
+    int count = sizeof(cases) / sizeof(cases[0]);
+    int failed = 0;
+    for (int i = 0; i < count; ++i) {
+        int passed = run_case(&cases[i], 0);
+        passed &= run_case(&cases[i], 1);
+        if (passed) {
+            printf("ok      %s\n", cases[i].name);
+        }
+        else {
+            ++failed;
+        }
+    }
+    printf("%d of %d cases passed\n", count - failed, count);
+    return failed > 0;
+}
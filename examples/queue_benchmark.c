@@ -0,0 +1,121 @@
+#include "../header/queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#define EVENTS 10000000
+
+/* Throughput benchmark of the Queue
+ * A producer thread puts EVENTS values into the Queue while the main thread gets them, as the KeyListener and the game
+ *  loop do; the same is then done with the previous implementation of the Queue (a linked list allocating an item for
+ *  every value, protected by a mutex, reproduced below) for comparison
+ */
+
+// previous implementation of the Queue
+typedef struct RefItem {
+    int val;
+    struct RefItem *next;
+} RefItem;
+
+typedef struct {
+    RefItem *head;
+    RefItem *tail;
+    time_t lpt_sec;
+    long lpt_ms;
+    pthread_mutex_t mutex;
+} RefQueue;
+
+static int ref_empty(RefQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    int empty = (queue->head == NULL);
+    pthread_mutex_unlock(&queue->mutex);
+    return empty;
+}
+
+static void ref_put(RefQueue *queue, int val) {
+    RefItem *new = malloc(sizeof(RefItem));
+    new->val = val;
+    new->next = NULL;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->head == NULL) {
+        queue->head = new;
+        queue->tail = new;
+    }
+    else {
+        queue->tail->next = new;
+        queue->tail = new;
+    }
+    get_timestamp(&queue->lpt_sec, &queue->lpt_ms);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static int ref_get(RefQueue *queue) {
+    pthread_mutex_lock(&queue->mutex);
+    RefItem *tmp = queue->head;
+    int val = tmp->val;
+    queue->head = tmp->next;
+    if (queue->head == NULL) {
+        queue->tail = NULL;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    free(tmp);
+    return val;
+}
+
+static void* produce(void *args) {
+    Queue *queue = args;
+    for (int i = 1; i <= EVENTS; ++i) {
+        queue_put(queue, i);
+    }
+    return NULL;
+}
+
+static void* ref_produce(void *args) {
+    RefQueue *queue = args;
+    for (int i = 1; i <= EVENTS; ++i) {
+        ref_put(queue, i);
+    }
+    return NULL;
+}
+
+static void report(const char *name, long long start, long long end, long long sum) {
+    double seconds = (end - start) / 1e9;
+    printf("%-24s %8.3f s  %8.2f Mevents/s  %6.1f ns/event  (checksum %lld)\n", name, seconds,
+           EVENTS / seconds / 1e6, (end - start) / (double)EVENTS, sum);
+}
+
+int main() {
+    pthread_t producer;
+    long long sum, start;
+
+    // ring buffer; the producer waits when it is full, so no value is lost
+    Queue *queue = init_queue_capacity(QUEUE_DEFAULT_CAPACITY, QUEUE_OVERFLOW_BLOCK);
+    sum = 0;
+    start = get_monotonic_ns();
+    pthread_create(&producer, NULL, produce, queue);
+    for (int i = 0; i < EVENTS; ++i) {
+        while (queue_empty(queue)) {
+            sched_yield();
+        }
+        sum += queue_get(queue);
+    }
+    pthread_join(producer, NULL);
+    report("ring buffer (SPSC)", start, get_monotonic_ns(), sum);
+    delete_queue(queue);
+
+    // previous implementation
+    RefQueue ref = {NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+    sum = 0;
+    start = get_monotonic_ns();
+    pthread_create(&producer, NULL, ref_produce, &ref);
+    for (int i = 0; i < EVENTS; ++i) {
+        while (ref_empty(&ref)) {
+            sched_yield();
+        }
+        sum += ref_get(&ref);
+    }
+    pthread_join(producer, NULL);
+    report("mutex + malloc (previous)", start, get_monotonic_ns(), sum);
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "../header/queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+// number of values put by the producer thread of the stress case
+#define EVENTS 200000
+// delay after which the helper thread of a case acts, in nanoseconds
+#define DELAY_NS 20000000LL
+
+/* Test of the blocking wait of the Queue (see queue_wait_until)
+ * The event file descriptor of a Queue can be readable while the Queue is empty: a value put while the consumer is
+ *  already reading the previous ones signals it, and so can values discarded by their policies; each case below
+ *  signals it without a value, from the main thread or while it waits, and checks that the wait only ends once a value
+ *  is available, the deadline has passed or the Queue is finished
+ * The last case has a producer thread put EVENTS values while the main thread waits for them and drains them as the
+ *  game loop would, checking that every wait which returns 1 finds a value, and that every value arrives in order
+ * Exits with 1 if any case fails
+ */
+
+/* What the helper thread of a case does, DELAY_NS after it starts and then again DELAY_NS later
+ * Queue *queue: the Queue of the case
+ * int signal: if set, first signals the event file descriptor of the Queue without putting a value
+ * int put: if set, then puts the value 1 into the Queue
+ * int finish: if set, then finishes the Queue (see queue_finish)
+ */
+typedef struct {
+    Queue *queue;
+    int signal;
+    int put;
+    int finish;
+} Helper;
+
+/* Signals the event file descriptor of a Queue, as a value put while the consumer waits would
+ */
+static void signal_event_fd(Queue *queue) {
+    uint64_t one = 1;
+    write(queue_event_fd(queue), &one, sizeof(one));
+}
+
+/* Runs the helper thread of a case (see Helper)
+ */
+static void *run_helper(void *args) {
+    Helper *helper = args;
+    sleep_until_ns(get_monotonic_ns() + DELAY_NS);
+    if (helper->signal) {
+        signal_event_fd(helper->queue);
+    }
+    sleep_until_ns(get_monotonic_ns() + DELAY_NS);
+    if (helper->put) {
+        queue_put(helper->queue, 1);
+    }
+    if (helper->finish) {
+        queue_finish(helper->queue);
+    }
+    return NULL;
+}
+
+/* Prints the result of a case
+ * Return: 1 if the case passed, else 0
+ */
+static int report(const char *name, int passed) {
+    printf("%s  %s\n", passed ? "ok    " : "FAILED", name);
+    return passed;
+}
+
+/* Waits without a deadline while the helper thread of a case runs
+ * Return: the value returned by queue_wait_until
+ */
+static int wait_with_helper(Queue *queue, int signal, int put, int finish) {
+    Helper helper = {queue, signal, put, finish};
+    pthread_t thread;
+    pthread_create(&thread, NULL, run_helper, &helper);
+    int result = queue_wait_until(queue, -1);
+    pthread_join(thread, NULL);
+    return result;
+}
+
+/* Runs the producer thread of the stress case, putting the values 1 to EVENTS in order
+ */
+static void *run_producer(void *args) {
+    Queue *queue = args;
+    for (int i = 1; i <= EVENTS; ++i) {
+        queue_put(queue, i);
+        // leave the consumer time to empty the Queue now and then, so it waits often
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+int main() {
+    int passed = 1;
+
+    // signalled before waiting with a deadline: the wait must last until the deadline
+    Queue *queue = init_queue();
+    signal_event_fd(queue);
+    long long start = get_monotonic_ns();
+    int result = queue_wait_until(queue, start + DELAY_NS);
+    passed &= report("signal before waiting with a deadline",
+                     result == 0 && get_monotonic_ns() - start >= DELAY_NS && queue_empty(queue));
+    delete_queue(queue);
+
+    // signalled before waiting without a deadline: the wait must last until a value is put
+    queue = init_queue();
+    signal_event_fd(queue);
+    result = wait_with_helper(queue, 0, 1, 0);
+    passed &= report("signal before waiting without a deadline", result == 1 && !queue_empty(queue));
+    delete_queue(queue);
+
+    // signalled while waiting without a deadline: the wait must last until a value is put
+    queue = init_queue();
+    result = wait_with_helper(queue, 1, 1, 0);
+    passed &= report("signal while waiting without a deadline", result == 1 && !queue_empty(queue));
+    delete_queue(queue);
+
+    // signalled while waiting, then finished: the wait must end without a value
+    queue = init_queue();
+    result = wait_with_helper(queue, 1, 0, 1);
+    passed &= report("signal then finish while waiting", result == 0 && queue_empty(queue));
+    delete_queue(queue);
+
+    // producer racing a consumer which waits whenever it has emptied the Queue
+    queue = init_queue_capacity(QUEUE_DEFAULT_CAPACITY, QUEUE_OVERFLOW_BLOCK);
+    pthread_t producer;
+    pthread_create(&producer, NULL, run_producer, queue);
+    int buffer[64];
+    int expected = 1;
+    int empty_wakeups = 0;
+    int disordered = 0;
+    while (expected <= EVENTS) {
+        if (!queue_wait_until(queue, -1) || queue_empty(queue)) {
+            ++empty_wakeups;
+            continue;
+        }
+        size_t count = queue_drain(queue, buffer, 64);
+        for (size_t i = 0; i < count; ++i) {
+            disordered += buffer[i] != expected++;
+        }
+    }
+    pthread_join(producer, NULL);
+    printf("        %d values, %d waits returned without a value, %d values out of order\n", EVENTS, empty_wakeups,
+           disordered);
+    passed &= report("producer racing a draining consumer", empty_wakeups == 0 && disordered == 0);
+    delete_queue(queue);
+
+    printf("%s\n", passed ? "ok" : "FAILED");
+    return !passed;
+}
@@ -0,0 +1,84 @@
+#ifndef TENGINE_BACKEND_H
+#define TENGINE_BACKEND_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "display.h"
+#include "encoder.h"
+
+// types of output backends (see Backend)
+// BACKEND_TERMINAL: frames are written to the terminal (stdout), whose size the Displays follow
+#define BACKEND_TERMINAL 0
+// BACKEND_MEMORY: the cells of the last frames are kept in memory, along with a checksum of each
+#define BACKEND_MEMORY 1
+// BACKEND_FILE: frames are written to a file, as they would be to the terminal
+#define BACKEND_FILE 2
+// BACKEND_NULL: frames are encoded, but discarded
+#define BACKEND_NULL 3
+// BACKEND_CUSTOM: frames are passed to a function of the game (see init_backend)
+#define BACKEND_CUSTOM 4
+// seed of the checksums of a memory backend (FNV-1a offset basis)
+#define BACKEND_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+/* Defines a frame kept by a memory backend
+ * unsigned long frame: number of the frame, counting from 1
+ * int rows, columns: size of the frame
+ * uint32_t *cells: glyph id of each cell, row by row (see display_get_id)
+ * uint32_t *styles: style of each cell, row by row
+ * size_t bytes: number of bytes the frame was encoded into
+ * uint64_t checksum: checksum of the size, cells and styles of the frame; frames with the same contents have the same
+ *  checksum, however they were encoded
+ * int _capacity: number of cells cells and styles have room for
+ */
+typedef struct {
+    unsigned long frame;
+    int rows;
+    int columns;
+    uint32_t *cells;
+    uint32_t *styles;
+    size_t bytes;
+    uint64_t checksum;
+    int _capacity;
+} BackendFrame;
+
+/* Defines a Backend, which receives the frames presented by a Drawer (see drawer_set_backend)
+ * Frames are presented once they are encoded, on the presenter thread of the Drawer (see every_frame); the Display
+ *  presented is the front buffer, which isn't touched by the game loop until the frame is presented
+ * int type: BACKEND_TERMINAL, BACKEND_MEMORY, BACKEND_FILE, BACKEND_NULL or BACKEND_CUSTOM
+ * ssize_t (*present)(struct Backend *backend, const Display *display, Encoder *encoder): presents a frame, given the
+ *  Display and the Encoder it was just encoded by; returns the number of bytes written, or -1 on error
+ * void *ctx: context of a custom backend
+ * int every_frame: if set, every frame is presented, on the drawer thread, as soon as it is published; otherwise frames
+ *  are presented by the presenter thread, which skips frames published while it was busy (see drawer_draw_display)
+ * int fd: file descriptor written to by terminal and file backends, else -1
+ * unsigned long frames: number of frames presented
+ * unsigned long long bytes: number of bytes the frames presented were encoded into
+ * uint64_t checksum: checksum of every frame kept by a memory backend, chained in order; equal for two runs drawing the
+ *  same frames
+ * BackendFrame *_frames: the last frames kept by a memory backend, as a ring buffer
+ * int _capacity: number of frames a memory backend keeps
+ */
+typedef struct Backend {
+    int type;
+    ssize_t (*present)(struct Backend *backend, const Display *display, Encoder *encoder);
+    void *ctx;
+    int every_frame;
+    int fd;
+    unsigned long frames;
+    unsigned long long bytes;
+    uint64_t checksum;
+    BackendFrame *_frames;
+    int _capacity;
+} Backend;
+
+// Backend operations
+Backend* init_backend(ssize_t (*present)(Backend *backend, const Display *display, Encoder *encoder), void *ctx);
+Backend* init_terminal_backend();
+Backend* init_memory_backend(int frames);
+Backend* init_file_backend(const char *path);
+Backend* init_null_backend();
+void delete_backend(Backend *backend);
+void backend_present(Backend *backend, const Display *display, Encoder *encoder);
+const BackendFrame* backend_frame(const Backend *backend, int age);
+
+#endif //TENGINE_BACKEND_H
@@ -0,0 +1,30 @@
+#ifndef TENGINE_CELLS_H
+#define TENGINE_CELLS_H
+
+#include <stdint.h>
+#include "display.h"
+
+// the kernels below treat each cell as one 32-bit value (a glyph id or a style)
+_Static_assert(CELLBYTES == sizeof(uint32_t), "cell kernels require CELLBYTES == 4");
+// versions of the kernels (see cells_set_kernels)
+// CELLS_AUTO: the best version the CPU supports (default)
+#define CELLS_AUTO 0
+#define CELLS_AVX2 1
+#define CELLS_SSE2 2
+#define CELLS_SCALAR 3
+
+/* Kernels operating on runs of Display cells, used by the bulk drawing operations of Display
+ * Each kernel has AVX2 and SSE2 versions, as well as a scalar fallback; the AVX2 version is chosen at runtime if the
+ *  CPU supports it, the SSE2 version is used on any other x86 CPU, and the scalar version on every other architecture
+ * Cells are accessed with unaligned loads and stores, so any run of cells can be passed as dst or src
+ * A version can also be chosen explicitly (see cells_set_kernels), so that every version can be tested on one machine
+ */
+
+// Cell kernels
+int cells_set_kernels(int kernels);
+void cells_fill(uint32_t *dst, uint32_t value, int count);
+void cells_blit(uint32_t *dst, const uint32_t *src, int count, uint32_t key);
+void cells_blit_styled(uint32_t *dst, uint32_t *dst_style, const uint32_t *src, const uint32_t *src_style, int count,
+                       uint32_t key);
+
+#endif //TENGINE_CELLS_H
@@ -0,0 +1,50 @@
+#ifndef TENGINE_COMPOSITOR_H
+#define TENGINE_COMPOSITOR_H
+
+#include "display.h"
+
+// maximum number of layers of a Compositor
+#define MAX_LAYERS 8
+// number of composed frames whose damage is remembered; a target last composed longer ago than that is recomposed whole
+#define DAMAGE_HISTORY 4
+
+/* Defines a Compositor, which flattens a stack of layers into a single Display
+ * Each layer is a Display created by init_layer, whose empty cells are transparent (GLYPH_NONE); a cell of the
+ *  composed Display shows the topmost layer whose cell isn't transparent, with that layer's style, or a whitespace with
+ *  STYLE_DEFAULT if every layer is transparent there
+ * Layers keep their contents across frames and track what changed since they were last composed (see the damage ranges
+ *  of Display), so a layer which isn't redrawn costs nothing to compose; e.g. a background drawn once, an entity layer
+ *  cleared and redrawn on every frame and a HUD only changed when the score changes
+ * Composed Displays (targets) are only updated where some layer changed since they were last composed; as the targets
+ *  are the buffers of a swap chain, the damage of the last DAMAGE_HISTORY frames is kept, so a target composed a few
+ *  frames ago can be brought up to date
+ * Display *layers[MAX_LAYERS]: the layers, from bottom to top
+ * int layer_count: number of layers
+ * int _rows, _columns: size of every layer
+ * uint64_t *_history_rows[DAMAGE_HISTORY]: for each of the last frames composed, the bitmap of rows damaged in that
+ *  frame (in any layer); the damage of frame n is kept at index n % DAMAGE_HISTORY
+ * int *_history_start[DAMAGE_HISTORY], *_history_end[DAMAGE_HISTORY]: for each of the last frames composed, the range of
+ *  columns [start, end) damaged in each row
+ * unsigned long frame: number of frames composed so far
+ * unsigned long _resize_frame: value of frame when the layers were last resized; targets composed before it are stale
+ */
+typedef struct {
+    Display *layers[MAX_LAYERS];
+    int layer_count;
+    int _rows;
+    int _columns;
+    uint64_t *_history_rows[DAMAGE_HISTORY];
+    int *_history_start[DAMAGE_HISTORY];
+    int *_history_end[DAMAGE_HISTORY];
+    unsigned long frame;
+    unsigned long _resize_frame;
+} Compositor;
+
+// Compositor operations
+Compositor* init_compositor(int rows, int columns);
+void delete_compositor(Compositor *compositor);
+Display* compositor_add_layer(Compositor *compositor);
+void compositor_resize(Compositor *compositor, int rows, int columns);
+void compositor_compose(Compositor *compositor, Display *target, unsigned long *composed);
+
+#endif //TENGINE_COMPOSITOR_H
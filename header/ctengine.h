@@ -1,5 +1,12 @@
 #ifndef TENGINE_TENGINE_H
 #define TENGINE_TENGINE_H
+#include "backend.h"
 #include "drawer.h"
+#include "engine.h"
+#include "entities.h"
+#include "grid.h"
+#include "jobs.h"
 #include "keylistener.h"
+#include "replay.h"
+#include "rng.h"
 #endif //TENGINE_TENGINE_H
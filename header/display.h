@@ -1,29 +1,105 @@
 #ifndef TENGINE_DISPLAY_H
 #define TENGINE_DISPLAY_H
-// constant defining bytes per screen cell (def. 4)
+
+#include <stdint.h>
+#include "glyph.h"
+// constant defining bytes per screen cell, which holds a 32-bit glyph id (def. 4)
 #define CELLBYTES 4
+// number of rows tracked by each word of a Display's dirty-row bitmap
+#define DIRTY_WORD_BITS 64
+// number of words needed for the dirty-row bitmap of a Display with the given number of rows
+#define DIRTY_WORDS(rows) (((rows) + DIRTY_WORD_BITS - 1) / DIRTY_WORD_BITS)
+
+// Cell styles
+// A style packs a foreground colour, a background colour and attribute flags into 32 bits, and is combined with "|",
+//  e.g. STYLE_FG(COLOR_RED) | STYLE_BOLD; colours are indices of the terminal's 256-colour palette
+// STYLE_DEFAULT: the terminal's default colours, with no attributes
+#define STYLE_DEFAULT 0
+#define STYLE_FG_SET 0x10000
+#define STYLE_BG_SET 0x20000
+#define STYLE_BOLD 0x40000
+#define STYLE_UNDERLINE 0x80000
+#define STYLE_REVERSE 0x100000
+#define STYLE_FG(color) (STYLE_FG_SET | ((uint32_t)(color) & 0xff))
+#define STYLE_BG(color) (STYLE_BG_SET | (((uint32_t)(color) & 0xff) << 8))
+// the foreground and background colours of a style
+#define STYLE_FG_COLOR(style) ((style) & 0xff)
+#define STYLE_BG_COLOR(style) (((style) >> 8) & 0xff)
+// the 16 standard colours of the palette
+#define COLOR_BLACK 0
+#define COLOR_RED 1
+#define COLOR_GREEN 2
+#define COLOR_YELLOW 3
+#define COLOR_BLUE 4
+#define COLOR_MAGENTA 5
+#define COLOR_CYAN 6
+#define COLOR_WHITE 7
+#define COLOR_BRIGHT(color) ((color) + 8)
 
 /* Defines a Display, which is used to represent the terminal screen
  * int _rows: number of rows of the current display
  * int _columns: number of columns of the current display
- * char *_display_array: 2D array of "cells", each of which represents one character on the terminal screen
- * char *empty: Whitespace char followed by CELLBYTES*'\0'
+ * uint32_t *_display_array: 2D array of "cells", each of which represents one character on the terminal screen; cells
+ *  hold glyph ids (see glyph.h), so comparing or copying a cell is a single 32-bit operation
+ * uint32_t empty: glyph id of the whitespace character, which every cell holds after a clear
+ * uint32_t *_style_array: 2D array of cell styles, parallel to the display array (see STYLE_DEFAULT); kept as a separate
+ *  plane so that glyphs and styles can each be compared and filled as runs of 32-bit values
+ * uint64_t *_dirty_rows: bitmap with one bit per row, set if any cell of the row was set since the last clear
+ * int *_dirty_start, *_dirty_end: for each row, the range of columns [start, end) set since the last clear; a row whose
+ *  start isn't smaller than its end is clean
+ * Every cell outside the dirty ranges holds the empty character with STYLE_DEFAULT, which lets display_clear and the
+ *  Encoder only visit the cells which were actually drawn
+ * uint64_t *_damage_rows, int *_damage_start, int *_damage_end: same as the dirty rows and ranges, but covering every
+ *  cell changed (set or cleared) since the last call to display_reset_damage; used by the Compositor to only recompose
+ *  the parts of a layer which changed, however long ago they were drawn
  */
 typedef struct {
     int _rows;
     int _columns;
-    char *_display_array;
-    char empty[CELLBYTES];
+    uint32_t *_display_array;
+    uint32_t empty;
+    uint32_t *_style_array;
+    uint64_t *_dirty_rows;
+    int *_dirty_start;
+    int *_dirty_end;
+    uint64_t *_damage_rows;
+    int *_damage_start;
+    int *_damage_end;
 } Display;
 
 // Display operations
 Display* init_display();
+Display* init_layer();
 void delete_display(Display *display);
 void display_update_size(Display *display);
+void display_resize(Display *display, int rows, int columns);
 int* display_get_size(Display *display);
+int display_rows(const Display *display);
+int display_cols(const Display *display);
 void display_clear(Display *display);
 char* display_get(Display *display, int row, int column);
+uint32_t display_get_id(const Display *display, int row, int column);
 void display_set(Display *display, int row, int column, const char *c);
 void display_set_exact(Display *display, int row, int column, const char *c);
+void display_set_id(Display *display, int row, int column, uint32_t id);
+int display_row_dirty(const Display *display, int row);
+void display_reset_damage(Display *display);
+uint32_t display_get_style(Display *display, int row, int column);
+void display_set_style(Display *display, int row, int column, uint32_t style);
+void display_set_styled(Display *display, int row, int column, const char *c, uint32_t style);
+void display_set_id_styled(Display *display, int row, int column, uint32_t id, uint32_t style);
+
+// Bulk drawing operations
+void display_fill_rect(Display *display, int row, int column, int height, int width, uint32_t id);
+void display_hline(Display *display, int row, int column, int length, uint32_t id);
+void display_vline(Display *display, int row, int column, int length, uint32_t id);
+void display_blit(Display *display, int row, int column, int height, int width, const uint32_t *cells,
+                  uint32_t transparent);
+void display_fill_style(Display *display, int row, int column, int height, int width, uint32_t style);
+void display_set_cells(Display *display, const int *rows, const int *columns, const uint32_t *ids, int count);
+
+// Utility functions
+uint32_t display_intern(const char *c);
+int terminal_get_size(int *rows, int *columns);
 
 #endif //TENGINE_DISPLAY_H
@@ -1,18 +1,57 @@
 #ifndef TENGINE_DRAWER_H
 #define TENGINE_DRAWER_H
 
+#include <limits.h>
 #include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include "backend.h"
+#include "compositor.h"
 #include "display.h"
+#include "encoder.h"
+#include "jobs.h"
 #include "queue.h"
 
 // value to clear terminal screen
 extern const char *CLEAR_SCREEN_ANSI;
+// value to reset the style of the terminal to its default
+extern const char *RESET_STYLE_ANSI;
+// number of Display buffers in the swap chain of a Drawer (back, ready and front)
+#define DISPLAY_BUFFERS 3
+// flag set in the ready index of a Drawer's swap chain when it holds a frame which hasn't been presented yet
+#define FRAME_FRESH 0x4
+// late-frame policies (see drawer_set_late_policy)
+// FRAME_LATE_SKIP: a late frame drops the deadlines it missed, and the following frames are paced from the next one
+#define FRAME_LATE_SKIP 0
+// FRAME_LATE_CATCHUP: deadlines are kept, so the frames following a late one are drawn without waiting until the
+//  schedule is met again
+#define FRAME_LATE_CATCHUP 1
+// maximum number of frames FRAME_LATE_CATCHUP may fall behind before the missed deadlines are dropped anyway
+#define MAX_CATCHUP_FRAMES 5
+
+/* Defines a GameloopFuncArgs struct, used to pass the required arguments to the game loop function
+ * Drawer *drawer: Pointer to the Drawer
+ * Queue *queue: Pointer to the shared Queue
+ */
+typedef struct {
+    struct Drawer *drawer;
+    Queue *queue;
+} GameloopFuncArgs;
 
 /* Defines a Drawer
- * time_t ld_sec: UNIX timestamp of last draw onto screen in seconds
- * long ld_msec: the millisecond part of the ld_sec timestamp
- * long update_delay_us: delay between each screen update in microseconds
- * Display *display: the Display used to represent the screen
+ * long long frame_period_ns: target time between two frames in nanoseconds; set by drawer_set_fps
+ * long long _deadline_ns: monotonic time (see get_monotonic_ns) at which the next frame is due; 0 before the first frame
+ * int late_policy: what to do when a frame misses its deadline; FRAME_LATE_SKIP (default) or FRAME_LATE_CATCHUP
+ * long long frame_time_ns: measured time between the last two frames in nanoseconds
+ * long long jitter_ns: difference between the last measured frame time and the target frame period
+ * long long max_jitter_ns: largest jitter_ns measured so far
+ * double avg_jitter_ns: mean of jitter_ns over all frames measured so far
+ * unsigned long frames_late: number of frames which missed their deadline by at least a whole frame period
+ * long long _last_frame_ns: monotonic time at which the last frame was published
+ * unsigned long _frames_measured: number of frame times measured so far
+ * Display *display: the Display used to represent the screen; this is the back buffer of the swap chain, which the
+ *  game loop draws onto, and it changes on every call to drawer_draw_display, so it shouldn't be saved across frames
  * pthread_t **thread_id: pointer to a pointer to the id value of the thread to run the drawer
  *  double pointer is required because the double pointer itself must be shared with the KeyListener, but must also be
  *  able to point to NULL initially (before the drawer thread is started); once the drawer thread is started, the double
@@ -20,34 +59,106 @@ extern const char *CLEAR_SCREEN_ANSI;
  *  KeyListener to know if the thread was started and free the pointer if necessary on exit, as well as warn in case the
  *  KeyListener was started without the drawer thread
  * char *exit_msg: message to be displayed on exit; set by drawer_set_exit_msg
+ * Encoder *encoder: the Encoder which turns the Display into the bytes written to the terminal on each frame; only used
+ *  by the presenter thread
+ * Compositor *compositor: holds the layers added by drawer_add_layer; if there are any, they are composed into the back
+ *  buffer when a frame is published
+ * Display *_buffers[DISPLAY_BUFFERS]: the swap chain; at any point, one buffer is the back buffer (drawn onto by the
+ *  game loop), one is the front buffer (being presented) and one is ready (the latest published frame)
+ * int _back: index of the back buffer; only used by the game loop thread
+ * atomic_int _ready: index of the ready buffer, with FRAME_FRESH set if it hasn't been presented yet; buffers are
+ *  exchanged with it atomically by both threads, so publishing a frame never blocks on the presenter
+ * int _front: index of the front buffer; only used by the presenter thread
+ * unsigned long _buffer_frame[DISPLAY_BUFFERS]: for each buffer, the frame of the Compositor it was last composed at, or
+ *  0 if it wasn't composed into
+ * unsigned long _presented_frame: frame of the Compositor the last presented buffer was composed at; only used by the
+ *  presenter thread, to detect composed frames which were never presented
+ * pthread_t _presenter_id: id of the presenter thread, which encodes published frames and presents them to the backend
+ * int _presenter_running: 1 if the presenter thread was started, else 0
+ * atomic_int _presenter_stop: set to 1 to make the presenter thread exit
+ * sem_t _present_sem: posted whenever a frame is published, so the presenter thread can sleep until there is work
+ * atomic_size_t _frame_bytes: number of bytes written to the terminal for the last presented frame
+ * GameloopFuncArgs _args: arguments passed to the game loop function by drawer_start_thread
+ * void *(*_gameloop)(void *args): the game loop function run by the drawer thread
+ * int _rows, _columns: current size of the terminal; every buffer is resized to it when it becomes the back buffer
+ * Backend *backend: where the presenter thread presents frames once they are encoded; a terminal backend by default
+ *  (see drawer_set_backend)
+ * int _own_backend: 1 if the backend was created by the Drawer, which then deletes it
+ * int fixed_size: if set, the Displays keep the size set by drawer_set_size instead of following the terminal's
+ * int paced: if set (default), drawer_draw_display waits until each frame is due; if not, frames are drawn as fast as
+ *  possible (e.g. replays, see replay.h)
+ * void (*_on_frame)(void *ctx): if set, called on the drawer thread whenever a frame is published (see drawer_on_frame)
+ * void *_on_frame_ctx: passed to every call of _on_frame
+ * long long (*_on_clock)(long long elapsed_ns, void *ctx): if set, called by engine_run on every frame with the time
+ *  elapsed since the previous frame, and returns the time the game should advance by instead (see drawer_on_clock)
+ * void *_on_clock_ctx: passed to every call of _on_clock
+ * JobSystem *jobs: the JobSystem the game loop can run jobs on (see jobs.h); started by drawer_start_thread, NULL before
+ * int _workers: number of worker threads of the JobSystem; JOBS_AUTO (default) for one per core besides the drawer
+ *  thread; set by drawer_set_workers
+ * sig_atomic_t _resize_generation: number of terminal resizes (counted by the SIGWINCH handler) the Displays last
+ *  followed; each Drawer keeps its own, so a resize is seen by every Drawer presenting to the terminal
  */
-typedef struct {
-    time_t ld_sec;
-    long ld_msec;
-    int update_delay_s;
-    long update_delay_ms;
+typedef struct Drawer {
+    long long frame_period_ns;
+    long long _deadline_ns;
+    int late_policy;
+    long long frame_time_ns;
+    long long jitter_ns;
+    long long max_jitter_ns;
+    double avg_jitter_ns;
+    unsigned long frames_late;
+    long long _last_frame_ns;
+    unsigned long _frames_measured;
     Display *display;
     pthread_t *thread_id;
     char *exit_msg;
+    Encoder *encoder;
+    Compositor *compositor;
+    Display *_buffers[DISPLAY_BUFFERS];
+    int _back;
+    atomic_int _ready;
+    int _front;
+    unsigned long _buffer_frame[DISPLAY_BUFFERS];
+    unsigned long _presented_frame;
+    pthread_t _presenter_id;
+    int _presenter_running;
+    atomic_int _presenter_stop;
+    sem_t _present_sem;
+    atomic_size_t _frame_bytes;
+    GameloopFuncArgs _args;
+    void *(*_gameloop)(void *args);
+    int _rows;
+    int _columns;
+    Backend *backend;
+    int _own_backend;
+    int fixed_size;
+    int paced;
+    void (*_on_frame)(void *ctx);
+    void *_on_frame_ctx;
+    long long (*_on_clock)(long long elapsed_ns, void *ctx);
+    void *_on_clock_ctx;
+    JobSystem *jobs;
+    int _workers;
+    sig_atomic_t _resize_generation;
 } Drawer;
 
-/* Defines a GameloopFuncArgs struct, used to pass the required arguments to the game loop function
- * Drawer *drawer: Pointer to the Drawer
- * Queue *queue: Pointer to the shared Queue
- */
-typedef struct {
-    Drawer *drawer;
-    Queue *queue;
-} GameloopFuncArgs;
-
 // Drawer functions
 Drawer* init_drawer();
 void delete_drawer(Drawer *drawer);
 void drawer_draw_display(Drawer *drawer);
 int drawer_set_fps(Drawer *drawer, int val);
+int drawer_set_late_policy(Drawer *drawer, int policy);
+int drawer_set_workers(Drawer *drawer, int workers);
 void drawer_start_thread(Drawer *drawer, Queue *queue, void *(*f)(void *args));
 void drawer_set_exit_msg(Drawer *drawer, const char* msg);
 void drawer_clear_exit_msg(Drawer *drawer);
+size_t drawer_frame_bytes(Drawer *drawer);
+Display* drawer_add_layer(Drawer *drawer);
+void drawer_set_backend(Drawer *drawer, Backend *backend);
+void drawer_set_size(Drawer *drawer, int rows, int columns);
+void drawer_resize(Drawer *drawer, int rows, int columns);
+void drawer_on_frame(Drawer *drawer, void (*f)(void *ctx), void *ctx);
+void drawer_on_clock(Drawer *drawer, long long (*f)(long long elapsed_ns, void *ctx), void *ctx);
 
 // Utility functions
 Drawer* args_get_drawer(void *args);
@@ -0,0 +1,63 @@
+#ifndef TENGINE_ENCODER_H
+#define TENGINE_ENCODER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "display.h"
+
+// maximum number of unchanged cells between two changed cells for them to be merged into the same run
+#define MERGE_GAP 2
+// maximum length of a cursor-positioning escape sequence ("\e[<row>;<column>H")
+#define CURSOR_SEQ_MAX 16
+// maximum length of an SGR escape sequence setting a cell style ("\e[0;1;4;7;38;5;<fg>;48;5;<bg>m")
+#define SGR_SEQ_MAX 32
+
+// value to erase the whole terminal screen, without moving the cursor
+extern const char *ERASE_SCREEN_ANSI;
+
+/* Defines an Encoder, which turns the contents of a Display into the bytes written to the terminal for one frame
+ * The glyphs of cells are packed into a contiguous UTF-8 buffer, and only cells which changed since the previously
+ *  encoded frame are included
+ * Cell styles are encoded as SGR escape sequences, which are only emitted when the style differs from the one of the
+ *  previously encoded cell
+ * uint32_t *_prev_array: copy of the display array as it was last encoded; used to only encode cells which changed
+ * uint32_t *_prev_style: copy of the style array of the Display as it was last encoded
+ * uint32_t _pen: style the terminal is currently set to, as of the end of the last encoded frame
+ * uint64_t *_prev_dirty_rows: dirty-row bitmap of the Display the previous frame was encoded from
+ * int *_prev_dirty_start, *_prev_dirty_end: dirty column ranges of the Display the previous frame was encoded from
+ * int _prev_rows, _prev_columns: size of _prev_array; if it doesn't match the Display, the whole frame is encoded
+ * int _rescan: set by encoder_rescan; the next frame compares every cell instead of only those in the dirty ranges
+ * char *_out: buffer in which the output of a frame is built; reused across frames
+ * size_t _out_cap: allocated size of _out in bytes
+ * size_t _out_len: number of bytes of the last encoded frame contained in _out
+ * size_t frame_bytes: number of bytes encoded for the last frame
+ * unsigned long long total_bytes: number of bytes encoded for all frames so far
+ * unsigned long frames: number of frames encoded so far
+ */
+typedef struct {
+    uint32_t *_prev_array;
+    uint32_t *_prev_style;
+    uint32_t _pen;
+    uint64_t *_prev_dirty_rows;
+    int *_prev_dirty_start;
+    int *_prev_dirty_end;
+    int _prev_rows;
+    int _prev_columns;
+    int _rescan;
+    char *_out;
+    size_t _out_cap;
+    size_t _out_len;
+    size_t frame_bytes;
+    unsigned long long total_bytes;
+    unsigned long frames;
+} Encoder;
+
+// Encoder operations
+Encoder* init_encoder();
+void delete_encoder(Encoder *encoder);
+size_t encoder_encode(Encoder *encoder, const Display *display);
+void encoder_invalidate(Encoder *encoder);
+void encoder_rescan(Encoder *encoder);
+ssize_t encoder_submit(Encoder *encoder, int fd);
+
+#endif //TENGINE_ENCODER_H
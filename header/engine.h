@@ -0,0 +1,42 @@
+#ifndef TENGINE_ENGINE_H
+#define TENGINE_ENGINE_H
+
+#include "display.h"
+#include "drawer.h"
+#include "queue.h"
+
+// default number of simulation steps per second of engine_run
+#define ENGINE_DEFAULT_TICK_RATE 60
+// default maximum number of simulation steps run before a frame is rendered; the rest of the time is dropped
+#define ENGINE_DEFAULT_MAX_STEPS 5
+
+/* Defines the callbacks of a game run by engine_run, along with its simulation rate and the counters engine_run keeps
+ * int (*update)(double dt, void *ctx): advances the game by a single simulation step, of dt seconds (always the same);
+ *  this is where events should be taken from the Queue and handled; returns 0 to keep running, or anything else to
+ *  make engine_run return
+ * void (*render)(Display *display, double alpha, void *ctx): draws the game onto the Display (the back buffer of the
+ *  Drawer); alpha, from 0 to 1, is how far the time of the frame is between the last simulation step and the next one,
+ *  so positions can be interpolated between their last two steps and movement looks smooth whatever the frame rate
+ * void *ctx: passed to every call of update and render
+ * int tick_rate: number of simulation steps per second; ENGINE_DEFAULT_TICK_RATE if 0
+ * int max_steps: maximum number of simulation steps run before each frame; ENGINE_DEFAULT_MAX_STEPS if 0
+ * unsigned long steps: number of simulation steps run so far; set by engine_run
+ * unsigned long frames: number of frames rendered so far; set by engine_run
+ * unsigned long dropped_steps: number of simulation steps which were dropped, because the game fell more than max_steps
+ *  behind; set by engine_run
+ */
+typedef struct {
+    int (*update)(double dt, void *ctx);
+    void (*render)(Display *display, double alpha, void *ctx);
+    void *ctx;
+    int tick_rate;
+    int max_steps;
+    unsigned long steps;
+    unsigned long frames;
+    unsigned long dropped_steps;
+} EngineCallbacks;
+
+// Engine functions
+void engine_run(Drawer *drawer, Queue *queue, EngineCallbacks *callbacks);
+
+#endif //TENGINE_ENGINE_H
@@ -0,0 +1,67 @@
+#ifndef TENGINE_ENTITIES_H
+#define TENGINE_ENTITIES_H
+
+#include <stdint.h>
+#include "display.h"
+
+// handle which never refers to an entity
+#define ENTITY_NONE 0
+// number of entities an EntityStore has room for when it is initialized; doubled whenever it is full
+#define ENTITIES_DEFAULT_CAPACITY 64
+// number of entities whose cells entities_render computes at a time
+#define ENTITIES_RENDER_BATCH 256
+
+/* Handle of an entity of an EntityStore
+ * The lower 32 bits hold the slot of the entity, and the upper 32 bits the generation of the slot, which changes
+ *  whenever an entity is removed from it, so handles of removed entities are never mistaken for newer ones
+ */
+typedef uint64_t EntityHandle;
+
+/* Defines an EntityStore, which holds the entities of a game as a structure of arrays: each component is a column,
+ *  holding the component of every entity contiguously, so kernels updating a component of every entity (see
+ *  entities_integrate) go through memory in order and process several entities per instruction
+ * Entities are kept packed at indices 0 to count - 1; removing an entity moves the last one into its place, so indices
+ *  change, while handles stay valid until their entity is removed (see entities_index)
+ * The world is toroidal, with the size of the Display: positions are in cells and wrap around its edges
+ * int count: number of entities
+ * int capacity: number of entities the columns have room for
+ * float *pos_row, *pos_col: position of each entity, in cells, from 0 (included) to the size of the world (excluded)
+ * float *vel_row, *vel_col: velocity of each entity, in cells per unit of dt (see entities_integrate)
+ * uint32_t *glyph: glyph id each entity is drawn with (see display_intern)
+ * uint32_t *_slot: slot of each entity
+ * uint32_t *_index: index of the entity of each slot, or the next free slot if the slot is free
+ * uint32_t *_generation: generation of each slot
+ * uint32_t _slots: number of slots
+ * uint32_t _free: first free slot, or _slots if there is none
+ */
+typedef struct {
+    int count;
+    int capacity;
+    float *pos_row;
+    float *pos_col;
+    float *vel_row;
+    float *vel_col;
+    uint32_t *glyph;
+    uint32_t *_slot;
+    uint32_t *_index;
+    uint32_t *_generation;
+    uint32_t _slots;
+    uint32_t _free;
+} EntityStore;
+
+// EntityStore operations
+EntityStore* init_entities();
+void delete_entities(EntityStore *entities);
+EntityHandle entities_add(EntityStore *entities, float row, float column, float vel_row, float vel_col, uint32_t glyph);
+int entities_remove(EntityStore *entities, EntityHandle handle);
+int entities_alive(const EntityStore *entities, EntityHandle handle);
+int entities_index(const EntityStore *entities, EntityHandle handle);
+EntityHandle entities_handle(const EntityStore *entities, int index);
+void entities_clear(EntityStore *entities);
+
+// Bulk operations
+void entities_integrate(EntityStore *entities, float dt, int rows, int columns);
+void entities_integrate_range(EntityStore *entities, int begin, int end, float dt, int rows, int columns);
+void entities_render(const EntityStore *entities, Display *display);
+
+#endif //TENGINE_ENTITIES_H
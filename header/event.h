@@ -0,0 +1,52 @@
+#ifndef TENGINE_EVENT_H
+#define TENGINE_EVENT_H
+
+#include <limits.h>
+#include <stdint.h>
+
+// event types
+// EVENT_NONE: no event; marks events of the Queue superseded by newer ones (see queue_set_policy)
+#define EVENT_NONE 0
+// EVENT_KEY: a mapped key was pressed; value holds the value the key is mapped to
+#define EVENT_KEY 1
+// EVENT_KEY_REPEAT: same as EVENT_KEY, but the key is the same as the previous one and followed it closely enough to
+//  be repeated by the terminal while the key is held down: within the press hold time of the InputState (see
+//  INPUT_PRESS_HOLD_NS) for the first repeat after a press, which covers the terminal's repeat delay, and within
+//  KEY_REPEAT_NS for the following ones
+#define EVENT_KEY_REPEAT 2
+// EVENT_RESIZE: the terminal was resized; placed in the Queue by the Drawer, once its Displays have the new size
+#define EVENT_RESIZE 3
+// EVENT_QUIT: the game should exit; placed in the Queue by the KeyListener, with value 0
+#define EVENT_QUIT 4
+// maximum time between a repeat and the next identical key for that key to be an EVENT_KEY_REPEAT as well, in
+//  nanoseconds
+#define KEY_REPEAT_NS 100000000LL
+// value of EVENT_RESIZE events, which is what queue_get returns for them
+#define RESIZE_EVENT INT_MIN
+
+// modifier flags of key events, as far as they can be told from the bytes sent by the terminal
+// MOD_SHIFT: upper-case letter, or a sequence with a shift modifier parameter ("\e[1;2A")
+#define MOD_SHIFT 0x1
+// MOD_ALT: key preceded by ESC, or a sequence with an alt modifier parameter
+#define MOD_ALT 0x2
+// MOD_CTRL: control character (CTRL+letter), or a sequence with a control modifier parameter
+#define MOD_CTRL 0x4
+
+/* Defines an Event, the fixed-size record carried by the Queue
+ * long long time_ns: monotonic time (see get_monotonic_ns) at which the event happened; for keys, the time at which the
+ *  KeyListener read them
+ * int value: the value of the event; for keys, the value the key is mapped to
+ * uint16_t type: one of the EVENT_ types
+ * uint16_t modifiers: combination of the MOD_ flags
+ */
+typedef struct {
+    long long time_ns;
+    int value;
+    uint16_t type;
+    uint16_t modifiers;
+} Event;
+
+// the ring buffer of the Queue holds 4 Events per cache line
+_Static_assert(sizeof(Event) == 16, "Event must be 16 bytes");
+
+#endif //TENGINE_EVENT_H
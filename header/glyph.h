@@ -0,0 +1,38 @@
+#ifndef TENGINE_GLYPH_H
+#define TENGINE_GLYPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// maximum number of bytes of an interned glyph (enough for a character followed by combining characters)
+#define GLYPH_MAX_BYTES 16
+// maximum number of glyphs which can be interned, besides the ASCII ones
+#define GLYPH_MAX 4096
+// number of slots of the glyph hash table; twice GLYPH_MAX, so probe sequences stay short
+#define GLYPH_SLOTS (2 * GLYPH_MAX)
+// id of "no glyph"; never produced by glyph_intern, and encoded as a whitespace (used as a transparency key)
+#define GLYPH_NONE 0
+// ids of ASCII characters are the characters themselves; interned glyphs are numbered from GLYPH_FIRST on
+#define GLYPH_FIRST 128
+// id returned by glyph_intern when the glyph table is full
+#define GLYPH_INVALID '?'
+
+/* Defines a Glyph, the UTF-8 representation of the character displayed by a cell
+ * char bytes[GLYPH_MAX_BYTES]: the UTF-8 bytes of the glyph (not '\0'-terminated if it is GLYPH_MAX_BYTES long)
+ * unsigned char len: number of bytes used
+ *
+ * Cells of a Display store 32-bit glyph ids instead of the glyphs themselves; the glyph table, shared by every Display,
+ *  maps each glyph to its id once (interning), so comparing or copying cells never touches the glyphs' bytes
+ * The table has a fixed capacity and is never moved, so lookups don't need a lock; only adding a glyph to it does
+ */
+typedef struct {
+    char bytes[GLYPH_MAX_BYTES];
+    unsigned char len;
+} Glyph;
+
+// Glyph table operations
+uint32_t glyph_intern(const char *c, size_t max_len);
+const Glyph* glyph_get(uint32_t id);
+size_t glyph_encode(char *out, uint32_t id);
+
+#endif //TENGINE_GLYPH_H
@@ -0,0 +1,55 @@
+#ifndef TENGINE_GRID_H
+#define TENGINE_GRID_H
+
+#include <stddef.h>
+#include "entities.h"
+
+// value of the cell of an entity which isn't in the Grid, and of the link after the last entity of a cell
+#define GRID_NONE -1
+
+/* Defines a Grid, the broadphase of collision detection: a uniform grid with a bucket for every cell of the world (the
+ *  toroidal world of an EntityStore, the size of the Display), holding the entities whose position is in that cell
+ * Entities are linked into the list of their cell through their slot (see EntityStore), so adding, moving or removing an
+ *  entity is O(1) and allocates nothing; grid_update only relinks the entities which changed cell since the last update,
+ *  which is usually a small part of them
+ * Queries only visit the cells they cover, so their cost depends on the size of the area queried and the number of
+ *  entities found there, not on the number of entities in the world; two entities collide if they are in the same cell
+ * int rows, columns: size of the world, in cells
+ * int count: number of entities in the Grid
+ * unsigned long moved: number of entities linked into another cell by the last call to grid_update
+ * int *_head: first entity (slot) of each cell, or GRID_NONE
+ * int *_next, *_prev: next and previous entity (slot) of the cell of each slot, or GRID_NONE
+ * int *_cell: cell of each slot, or GRID_NONE if the slot isn't in the Grid
+ * EntityHandle *_handle: handle of the entity of each slot in the Grid
+ * unsigned int *_seen: value of _stamp when each slot was last seen by grid_update
+ * unsigned int _stamp: incremented by every call to grid_update
+ * int _slots: number of slots the arrays above have room for
+ */
+typedef struct {
+    int rows;
+    int columns;
+    int count;
+    unsigned long moved;
+    int *_head;
+    int *_next;
+    int *_prev;
+    int *_cell;
+    EntityHandle *_handle;
+    unsigned int *_seen;
+    unsigned int _stamp;
+    int _slots;
+} Grid;
+
+// Grid operations
+Grid* init_grid(int rows, int columns);
+void delete_grid(Grid *grid);
+void grid_resize(Grid *grid, int rows, int columns);
+void grid_update(Grid *grid, const EntityStore *entities);
+
+// Queries
+int grid_query_point(const Grid *grid, int row, int column, EntityHandle *out, int max);
+int grid_query_rect(const Grid *grid, int row, int column, int height, int width, EntityHandle *out, int max);
+int grid_query_radius(const Grid *grid, int row, int column, int radius, EntityHandle *out, int max);
+size_t grid_for_each_pair(const Grid *grid, void (*f)(EntityHandle a, EntityHandle b, void *ctx), void *ctx);
+
+#endif //TENGINE_GRID_H
@@ -0,0 +1,62 @@
+#ifndef TENGINE_INPUT_H
+#define TENGINE_INPUT_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// number of actions whose state is tracked; actions are the values keys are mapped to, from 0 to INPUT_ACTIONS - 1
+#define INPUT_ACTIONS 256
+// number of 64-bit words of a bitset of actions
+#define INPUT_WORDS (INPUT_ACTIONS / 64)
+// default time an action stays down after a key press, in nanoseconds; covers the delay before the terminal starts
+//  repeating a key held down, and is also how long after a press the KeyListener takes the same key as its first repeat
+#define INPUT_PRESS_HOLD_NS 500000000LL
+// default time an action stays down after a repeat of its key, in nanoseconds; covers the interval between repeats
+#define INPUT_REPEAT_HOLD_NS 100000000LL
+
+/* Defines the state of the actions of the game, as far as it can be told from the keys read by the KeyListener
+ * Terminals only send key presses, never releases, so whether a key is held down is told from the repeats the terminal
+ *  sends while it is: an action is down from the press of its key until INPUT_PRESS_HOLD_NS pass without a repeat, then
+ *  stays down as long as repeats keep arriving within INPUT_REPEAT_HOLD_NS of each other, and is held once the first
+ *  repeat arrives; a key is a repeat if the KeyListener reports it as one (EVENT_KEY_REPEAT), so a second press of the
+ *  same key which comes too late to be a repeat is a new press, and never makes the action held
+ * Since terminals only repeat the last key pressed, pressing another key stops the repeats of a key still held, which
+ *  is then released as well
+ * Each KeyListener owns an InputState (keylistener->input), which only it writes to; the game loop reads it with a
+ *  single relaxed load per query, without going through the Queue
+ * _Atomic uint64_t down[INPUT_WORDS]: bitset of the actions which are down
+ * _Atomic uint64_t held[INPUT_WORDS]: bitset of the actions which are down and whose key is being repeated
+ * _Atomic long long press_ns[INPUT_ACTIONS]: monotonic time (see get_monotonic_ns) of the last press of each action
+ * long long _release_ns[INPUT_ACTIONS]: time at which each action which is down is released, unless repeated before
+ * long long _press_hold_ns, _repeat_hold_ns: time an action stays down after a press and after a repeat
+ * atomic_int quit: set once the KeyListener exits (e.g. CTRL+C was read), so a game loop which only queries the
+ *  InputState knows to return without reading EVENT_QUIT from the Queue (see input_quit_requested)
+ */
+typedef struct {
+    _Atomic uint64_t down[INPUT_WORDS];
+    _Atomic uint64_t held[INPUT_WORDS];
+    _Atomic long long press_ns[INPUT_ACTIONS];
+    long long _release_ns[INPUT_ACTIONS];
+    long long _press_hold_ns;
+    long long _repeat_hold_ns;
+    atomic_int quit;
+} InputState;
+
+// Input operations
+InputState* init_input();
+void delete_input(InputState *input);
+
+// Input operations (game loop)
+int input_is_down(const InputState *input, int action);
+int input_is_held(const InputState *input, int action);
+long long input_press_ns(const InputState *input, int action);
+void input_set_hold(InputState *input, long long press_hold_ns, long long repeat_hold_ns);
+int input_quit_requested(const InputState *input);
+
+// Input operations (KeyListener)
+void input_key(InputState *input, int action, long long now, int repeat);
+long long input_release_due(InputState *input, long long now);
+void input_reset(InputState *input);
+void input_quit(InputState *input);
+
+#endif //TENGINE_INPUT_H
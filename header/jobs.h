@@ -0,0 +1,118 @@
+#ifndef TENGINE_JOBS_H
+#define TENGINE_JOBS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// number of jobs each deque of a JobSystem holds (power of two); a job submitted to a full deque is run right away
+#define JOBS_DEQUE_SIZE 4096
+// maximum number of jobs which can depend on a single job (see job_depends_on)
+#define JOB_MAX_DEPENDENTS 8
+// maximum number of jobs a single jobs_parallel_for call splits its range into
+#define JOBS_MAX_CHUNKS 256
+// number of chunks per thread jobs_parallel_for aims for when it picks the grain itself, so that threads which finish
+//  early can steal from the others
+#define JOBS_CHUNKS_PER_THREAD 4
+// number of times an idle worker looks for a job before going to sleep
+#define JOBS_SPIN 64
+// states of a Job (see Job)
+#define JOB_OPEN 0
+#define JOB_LOCKED 1
+#define JOB_FINISHED 2
+// worker count which makes init_jobs create one worker per core, besides the owner thread
+#define JOBS_AUTO -1
+
+/* Defines a Job, a function to be run by a JobSystem once every job it depends on has finished
+ * Jobs are initialized in place with job_init, so they can live on the stack of the game loop, or in an array reused
+ *  across frames, and nothing is allocated per job; a Job must stay alive until it is finished (see jobs_wait)
+ * void (*f)(void *ctx): the function run by the job
+ * void *ctx: passed to f
+ * atomic_int _waiting: number of dependencies which haven't finished yet, plus 1 until the job is submitted; the job is
+ *  queued once it drops to 0
+ * atomic_int _state: JOB_OPEN, JOB_LOCKED while its dependents are being changed, or JOB_FINISHED
+ * struct Job *_dependents[JOB_MAX_DEPENDENTS]: jobs to be released when this one finishes
+ * int _dependents_count: number of _dependents
+ * struct Job *_next: next job of the injection queue of the JobSystem, while the job is in it (see JobSystem)
+ */
+typedef struct Job {
+    void (*f)(void *ctx);
+    void *ctx;
+    atomic_int _waiting;
+    atomic_int _state;
+    struct Job *_dependents[JOB_MAX_DEPENDENTS];
+    int _dependents_count;
+    struct Job *_next;
+} Job;
+
+/* Defines a work-stealing deque of jobs (Chase-Lev)
+ * Its owner thread pushes and pops jobs at the bottom, without any atomic read-modify-write unless a single job is left,
+ *  while the other threads steal jobs from the top
+ * _Atomic long _top: index of the oldest job, advanced by steals and by the owner when it pops the last job
+ * _Atomic long _bottom: index after the newest job; only written by the owner thread
+ * _Atomic(Job*) _jobs[JOBS_DEQUE_SIZE]: the jobs, as a ring buffer
+ */
+typedef struct {
+    _Alignas(64) _Atomic long _top;
+    _Alignas(64) _Atomic long _bottom;
+    _Atomic(Job*) _jobs[JOBS_DEQUE_SIZE];
+} JobDeque;
+
+/* Defines a JobSystem, a pool of worker threads running jobs submitted by the game loop
+ * Every worker has its own deque, and so does the owner thread (the game loop thread, see jobs_set_owner): jobs are
+ *  pushed to the deque of the thread which submits them (or finishes their last dependency) and taken back from it
+ *  newest first, which keeps the data they touch in cache, while idle threads steal the oldest jobs of the others, which
+ *  tend to be the largest ones
+ * A deque only has a single thread pushing and popping at its bottom, so jobs submitted by any other thread go through
+ *  the injection queue instead, a list shared by those threads and protected by a lock, from which every thread takes
+ *  jobs before stealing; the owner thread runs jobs as well while it waits for them (see jobs_wait), and so do other
+ *  threads waiting for a job
+ * The worker threads are only started once the first job is submitted, so a game which never uses the JobSystem has no
+ *  threads waiting for jobs
+ * Idle workers spin for a while, then sleep until a job is queued
+ * int workers: number of worker threads
+ * JobDeque *_deques: workers + 1 deques; deque 0 belongs to the owner thread, and deque i to worker i
+ * pthread_t *_threads: ids of the worker threads
+ * pthread_t _owner: the thread owning deque 0
+ * atomic_int _started: set once the worker threads are started
+ * Job *_inject_head, *_inject_tail: the injection queue, oldest job first, linked by the _next field of the jobs
+ * atomic_int _injected: number of jobs in the injection queue, so that taking a job only takes its lock if there are any
+ * pthread_mutex_t _inject_lock: protects the injection queue
+ * atomic_int _queued: number of jobs in the deques and the injection queue, so that workers know when to go to sleep
+ * atomic_int _sleeping: number of workers sleeping, so that submitting a job only takes the lock if there are any
+ * atomic_int _stop: set to 1 to make the workers exit
+ * pthread_mutex_t _lock: protects _wake and the start of the workers
+ * pthread_cond_t _wake: signalled when a job is queued while workers are sleeping
+ */
+typedef struct {
+    int workers;
+    JobDeque *_deques;
+    pthread_t *_threads;
+    pthread_t _owner;
+    atomic_int _started;
+    Job *_inject_head;
+    Job *_inject_tail;
+    atomic_int _injected;
+    pthread_mutex_t _inject_lock;
+    atomic_int _queued;
+    atomic_int _sleeping;
+    atomic_int _stop;
+    pthread_mutex_t _lock;
+    pthread_cond_t _wake;
+} JobSystem;
+
+// JobSystem functions
+JobSystem* init_jobs(int workers);
+void delete_jobs(JobSystem *jobs);
+void jobs_set_owner(JobSystem *jobs);
+void jobs_submit(JobSystem *jobs, Job *job);
+void jobs_wait(JobSystem *jobs, Job *job);
+void jobs_parallel_for(JobSystem *jobs, size_t begin, size_t end, size_t grain,
+                       void (*f)(size_t begin, size_t end, void *ctx), void *ctx);
+
+// Job functions
+void job_init(Job *job, void (*f)(void *ctx), void *ctx);
+int job_depends_on(Job *job, Job *dependency);
+int job_finished(Job *job);
+
+#endif //TENGINE_JOBS_H
@@ -4,8 +4,13 @@
 #include <termios.h>
 #include "queue.h"
 #include "keymap.h"
+#include "keyparser.h"
+#include "input.h"
 #include "drawer.h"
 
+// number of bytes read from stdin at once; a read can contain many keys (see KeyParser)
+#define KEYLISTENER_BUFFER 1024
+
 /* Defines a KeyListener, which is used to listen for key press events and translate them into values to be placed in
  *  a shared Queue
  * int fd: STDIN file descriptor
@@ -14,6 +19,13 @@
  * int oldflags: terminal flags before KeyListener initialization
  * Queue *eQueue: shared Queue
  * KeyMap *rec_keycodes: KeyMap mapping key presses to integer values
+ * KeyParser *parser: KeyParser splitting the bytes read from stdin into keys
+ * InputState *input: state of the actions, kept up to date with the keys read; the game loop can query it instead of
+ *  reading the Queue (see input_is_down), until the KeyListener is deleted
+ * int last_value: value of the last key placed in the Queue, used to tell repeated keys apart (see EVENT_KEY_REPEAT)
+ * long long last_key_ns: monotonic time (see get_monotonic_ns) at which the last key placed in the Queue was read
+ * int last_repeat: 1 if the last key placed in the Queue was a repeat; the first repeat of a press may come up to the
+ *  press hold time of the InputState after it (see input_set_hold), the following ones up to KEY_REPEAT_NS apart
  * pthread **drawer_thread_id: Double pointer initialized by init_drawer function
  */
 typedef struct {
@@ -22,6 +34,11 @@ typedef struct {
     int oldflags;
     Queue *eQueue;
     KeyMap *rec_keycodes;
+    KeyParser *parser;
+    InputState *input;
+    int last_value;
+    long long last_key_ns;
+    int last_repeat;
     Drawer *drawer;
 } KeyListener;
 
@@ -2,43 +2,54 @@
 #define TENGINE_KEYMAP_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <limits.h>
 #include <string.h>
-// DEFSIZE: size used by init_keymap
-#define DEFSIZE 17
 // KEYSIZE: maximum size for a character code (def. 5)
 #define KEYSIZE 5
+// KEYMAP_NONE: value returned by keymap_get for keys which aren't in the KeyMap; must not be used as a value
+#define KEYMAP_NONE INT_MAX
+// KEYMAP_SEEDS: number of hash functions tried for each table size when building the table of sequences
+#define KEYMAP_SEEDS 64
 
-/* Defines an item of a KeyMap
- * char key[KEYSIZE]: the character that the keypress sends to stdin
- * int val: the value that character is mapped to
- * struct KeyMapItem *next: the next item in the chain of the containing bucket
+/* Defines an item of a KeyMap holding a key longer than one byte (an escape sequence or a UTF-8 character)
+ * uint64_t key: the bytes the keypress sends to stdin, packed into an integer (see keymap_pack); 0 marks an empty slot
+ * int val: the value that key is mapped to
  */
-typedef struct KeyMapItem {
-    char key[KEYSIZE];
+typedef struct {
+    uint64_t key;
     int val;
-    struct KeyMapItem *next;
 } KeyMapItem;
 
 /* Defines a KeyMap, which maps key codes to integer values
- * int size: the size of the KeyMap
- * KeyMapItem **array: the array of size (size) containing "buckets", which contain chains of KeyMapItems,
- *  each with the corresponding hash
- * KeyMap uses hashing with chains; for each item, the operation (key[0] % size) is used to determine the index of the
- *  bucket where the item will be saved
- * If there are already items saved there, it is placed at the beginning of the chain, after which the previously first
- *  item follows it
+ * Keys of a single byte index a table of 256 values directly
+ * Longer keys are kept in a table built with a perfect hash: keymap_put picks the table size and the multiplier of a
+ *  multiplicative hash so that no two keys share a slot, so finding a key only takes a multiplication and a single
+ *  comparison, whichever key it is (e.g. escape sequences, which all start with ESC)
+ * Lookups never allocate memory or write to the KeyMap, so the KeyMap can be read by several threads at once
+ * int single[256]: value of each single-byte key, indexed by the byte, or KEYMAP_NONE
+ * KeyMapItem *_items: every longer key, in the order they were added
+ * int _count: number of items in _items
+ * int _capacity: number of items _items has room for
+ * KeyMapItem *_table: table of longer keys, in which each key is at index (key * _multiplier) >> (64 - _bits)
+ * int _bits: base 2 logarithm of the size of _table
+ * uint64_t _multiplier: multiplier of the hash of _table
  */
 typedef struct {
-    int size;
-    KeyMapItem **array;
+    int single[256];
+    KeyMapItem *_items;
+    int _count;
+    int _capacity;
+    KeyMapItem *_table;
+    int _bits;
+    uint64_t _multiplier;
 } KeyMap;
 
 // KeyMap operations
 KeyMap* init_keymap();
 void delete_keymap(KeyMap *keymap);
 void keymap_put(KeyMap *keymap, const char key[KEYSIZE], int val);
-int keymap_has(KeyMap *keymap, const char key[KEYSIZE]);
-int keymap_get(KeyMap *keymap, const char key[KEYSIZE]);
+int keymap_has(const KeyMap *keymap, const char key[KEYSIZE]);
+int keymap_get(const KeyMap *keymap, const char key[KEYSIZE]);
 
 #endif //TENGINE_KEYMAP_H
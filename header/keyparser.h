@@ -0,0 +1,64 @@
+#ifndef TENGINE_KEYPARSER_H
+#define TENGINE_KEYPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "event.h"
+#include "keymap.h"
+
+// time after an ESC at which, if the rest of an escape sequence hasn't arrived, it is taken to be the ESC key itself, in
+//  nanoseconds
+#define ESC_TIMEOUT_NS 25000000LL
+// maximum length of a sequence kept by a KeyParser; longer sequences (e.g. mouse reports) are discarded
+#define KEYPARSER_MAX_SEQUENCE 16
+
+// states of a KeyParser
+// KEYPARSER_GROUND: between keys
+// KEYPARSER_ESC: after an ESC, which is either the ESC key, ALT+key or the start of an escape sequence
+// KEYPARSER_CSI: inside a "\e[" sequence, until its final byte (0x40 to 0x7e)
+// KEYPARSER_SS3: inside a "\eO" sequence, until its final byte
+// KEYPARSER_UTF8: inside a multi-byte UTF-8 character
+#define KEYPARSER_GROUND 0
+#define KEYPARSER_ESC 1
+#define KEYPARSER_CSI 2
+#define KEYPARSER_SS3 3
+#define KEYPARSER_UTF8 4
+
+/* Defines a KeyParser, an incremental state machine splitting the bytes read from the terminal into keys
+ * Bytes are fed in whatever chunks they were read in, so a read can contain several keys (e.g. pasted text, or keys
+ *  repeating faster than they are read) and a key can be split across reads; the sequence of a key is kept until it is
+ *  complete, and each complete key is passed to a callback as a KEYSIZE array (see keymap.h), padded with zeroes
+ * Modifier parameters of escape sequences ("\e[1;5A", "\e[15;2~") are removed from the key and reported as modifiers
+ *  (see MOD_SHIFT), so the key matches the constants in CONST; likewise, ESC followed by a key which doesn't start an
+ *  escape sequence is reported as that key with MOD_ALT
+ * An ESC on its own can't be told apart from the start of a sequence until the next byte arrives, so it is only
+ *  reported once ESC_TIMEOUT_NS pass without one (see keyparser_deadline and keyparser_flush)
+ * Sequences too long to fit in a key, unterminated sequences and invalid UTF-8 bytes are discarded
+ * int state: one of the KEYPARSER_ states
+ * char _sequence[KEYPARSER_MAX_SEQUENCE]: bytes of the key being parsed
+ * int _length: number of bytes in _sequence
+ * int _overflow: set if the key being parsed is longer than KEYPARSER_MAX_SEQUENCE, so it is discarded once complete
+ * int _utf8_remaining: number of continuation bytes still expected in state KEYPARSER_UTF8
+ * uint16_t _modifiers: modifiers of the key being parsed
+ * long long _start_ns: monotonic time (see get_monotonic_ns) at which the first byte of the key being parsed was read
+ */
+typedef struct {
+    int state;
+    char _sequence[KEYPARSER_MAX_SEQUENCE];
+    int _length;
+    int _overflow;
+    int _utf8_remaining;
+    uint16_t _modifiers;
+    long long _start_ns;
+} KeyParser;
+
+// KeyParser operations
+KeyParser* init_keyparser();
+void delete_keyparser(KeyParser *parser);
+void keyparser_feed(KeyParser *parser, const char *bytes, size_t count, long long now,
+                    void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx), void *ctx);
+long long keyparser_deadline(KeyParser *parser);
+void keyparser_flush(KeyParser *parser, long long now,
+                     void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx), void *ctx);
+
+#endif //TENGINE_KEYPARSER_H
@@ -1,43 +1,142 @@
 #ifndef TENGINE_QUEUE_H
 #define TENGINE_QUEUE_H
 
+#include <stdatomic.h>
+#include <stddef.h>
 #include <time.h>
+#include "event.h"
 
-/* Defines a queue item containing an integer
- * int val: the value contained in the item
- * struct QueueItem *next: pointer to the item below this one in the queue
+// size of a cache line; the producer's and consumer's fields of a Queue are kept on separate cache lines
+#define QUEUE_CACHE_LINE 64
+// capacity of a Queue created by init_queue
+#define QUEUE_DEFAULT_CAPACITY 256
+// maximum number of events placed in a Queue by its consumer (see queue_put_local) which can be pending at once
+#define QUEUE_LOCAL_CAPACITY 4
+// overflow policies (see init_queue_capacity)
+// QUEUE_OVERFLOW_DROP: an event put into a full Queue is dropped, and queue_put returns 1
+#define QUEUE_OVERFLOW_DROP 0
+// QUEUE_OVERFLOW_BLOCK: queue_put waits until the consumer makes room for the event
+#define QUEUE_OVERFLOW_BLOCK 1
+// number of values which can be given a policy (0 to QUEUE_POLICIES - 1); other values use QUEUE_POLICY_KEEP
+#define QUEUE_POLICIES 64
+// number of groups of QUEUE_POLICY_LATEST values (0 to QUEUE_POLICY_GROUPS - 1)
+#define QUEUE_POLICY_GROUPS 64
+// policies of the key events of a value (see queue_set_policy)
+// QUEUE_POLICY_KEEP: every press is delivered, but a run of repeats (EVENT_KEY_REPEAT) is collapsed into its last one
+#define QUEUE_POLICY_KEEP 0
+// QUEUE_POLICY_LATEST: latest wins; only the newest pending event of the value's group is delivered (e.g. movement)
+#define QUEUE_POLICY_LATEST 1
+// QUEUE_POLICY_NEVER_DROP: every event is delivered, and waits for room instead of being dropped if the Queue is full
+//  (e.g. fire); TTLs don't apply
+#define QUEUE_POLICY_NEVER_DROP 2
+
+/* Defines the policy of the key events of a value (see queue_set_policy)
+ * int policy: one of the QUEUE_POLICY_ policies
+ * int group: for QUEUE_POLICY_LATEST, the group of values of which only the newest pending event is delivered
+ * long long ttl_ns: time after which a pending event is too old to be delivered, in nanoseconds, or 0 if it never is
  */
-typedef struct QueueItem {
-    int val;
-    struct QueueItem *next;
-} QueueItem;
+typedef struct {
+    int policy;
+    int group;
+    long long ttl_ns;
+} EventPolicy;
 
-/* Defines a thread-safe queue of QueueItems
- * QueueItem *head: the QueueItem which will be removed on the next get operation
- * QueueItem *tail: the QueueItem which was last added to the Queue
- * time_t lpt_sec: UNIX timestamp of last put operation called on the queue, in seconds
- * long lpt_ms: the millisecond part of the lpt_sec timestamp
- * pthread_mutex_t mutex: the mutex used to ensure mutual exclusion when queue is used with multiple threads
+/* Defines a lock-free queue of Events, with a single producer thread (the KeyListener) and a single consumer thread
+ *  (the game loop)
+ * Events are kept in a ring buffer of fixed capacity, so putting and getting one never allocates memory or takes a
+ *  lock: the producer only writes the tail index and the consumer only writes the head index, each publishing its
+ *  progress to the other with a single atomic store
+ * Indices grow without wrapping around (an event's slot is its index modulo the capacity), so the number of events
+ *  in the Queue is always tail - head
+ * Each side keeps a cached copy of the other side's index, and only reloads it when the cached copy says the Queue is
+ *  full (producer) or empty (consumer), so the cache line of the other side is rarely touched
+ * Key events are delivered according to the policy of their value (see queue_set_policy): before reading, the consumer
+ *  marks the pending events superseded by newer ones as EVENT_NONE, and skips those along with the ones older than
+ *  their TTL, so the game loop only sees events which are still relevant
+ *
+ * Producer side:
+ * atomic_size_t _tail: index of the next slot to be written
+ * size_t _head_cache: last value of _head read by the producer
+ * Consumer side:
+ * atomic_size_t _head: index of the next slot to be read
+ * size_t _tail_cache: last value of _tail read by the consumer
+ * Event _local[QUEUE_LOCAL_CAPACITY]: events placed by the consumer itself (see queue_put_local), read before the others
+ * int _local_count: number of events in _local
+ * size_t _coalesced: value of _tail_cache when the policies were last applied to the pending events
+ * int _direct: set once an event was put with queue_put_direct, after which the policies no longer apply
+ * void (*_observer)(const Event *event, void *ctx): if set, called on every event delivered to the consumer (see
+ *  queue_set_observer)
+ * void *_observer_ctx: passed to every call of _observer
+ * Shared:
+ * atomic_size_t _discard: every event with an index lower than this one is skipped by the consumer; set by queue_clear,
+ *  so that either thread can clear the Queue
+ * Event *_items: the ring buffer
+ * size_t capacity: number of slots of the ring buffer; always a power of two
+ * size_t _mask: capacity - 1
+ * int overflow_policy: what happens when an event is put into a full Queue; QUEUE_OVERFLOW_DROP or QUEUE_OVERFLOW_BLOCK
+ * atomic_ulong dropped: number of events dropped because the Queue was full
+ * EventPolicy _policies[QUEUE_POLICIES]: policy of the key events of each value (see queue_set_policy)
+ * int _ttl: set if any policy has a TTL, so the time is only read when reading events if needed
+ * int _event_fd: eventfd signalled by the producer when it puts an event while the consumer is waiting (see
+ *  queue_wait_until); can be polled along with other file descriptors (see queue_event_fd)
+ * atomic_int _waiting: set by the consumer while it waits on _event_fd, so the producer only signals it when needed and
+ *  putting an event doesn't require a system call otherwise
  * int finished: flag indicating whether execution is finished; used by reader thread to communicate event to writer thread
+ * int _finish_fd: eventfd signalled by queue_finish, so the writer thread can wait for it along with its input
  */
 typedef struct {
-    QueueItem *head;
-    QueueItem *tail;
-    time_t lpt_sec;
-    long lpt_ms;
-    pthread_mutex_t mutex;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t _tail;
+    size_t _head_cache;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t _head;
+    size_t _tail_cache;
+    Event _local[QUEUE_LOCAL_CAPACITY];
+    int _local_count;
+    size_t _coalesced;
+    int _direct;
+    void (*_observer)(const Event *event, void *ctx);
+    void *_observer_ctx;
+    _Alignas(QUEUE_CACHE_LINE) atomic_size_t _discard;
+    Event *_items;
+    size_t capacity;
+    size_t _mask;
+    int overflow_policy;
+    atomic_ulong dropped;
+    EventPolicy _policies[QUEUE_POLICIES];
+    int _ttl;
+    int _event_fd;
+    atomic_int _waiting;
     int finished;
+    int _finish_fd;
 } Queue;
 
 // Queue operations
 Queue* init_queue();
+Queue* init_queue_capacity(size_t capacity, int overflow_policy);
 void delete_queue(Queue *queue);
 int queue_empty(Queue *queue);
-void queue_put(Queue *queue, int val);
+int queue_put_event(Queue *queue, const Event *event);
+int queue_put(Queue *queue, int val);
+void queue_put_local(Queue *queue, const Event *event);
+int queue_put_direct(Queue *queue, const Event *event);
+void queue_get_event(Queue *queue, Event *event);
 int queue_get(Queue *queue);
+size_t queue_drain_events(Queue *queue, Event *buf, size_t max);
+size_t queue_drain(Queue *queue, int *buf, size_t max);
+size_t queue_for_each_event(Queue *queue, void (*f)(const Event *event, void *ctx), void *ctx);
+size_t queue_for_each_pending(Queue *queue, void (*f)(int val, void *ctx), void *ctx);
 void queue_clear(Queue *queue);
+void queue_set_policy(Queue *queue, int val, int policy, int group, long long ttl_ns);
+void queue_set_observer(Queue *queue, void (*f)(const Event *event, void *ctx), void *ctx);
+int queue_wait_until(Queue *queue, long long deadline);
+int queue_event_fd(Queue *queue);
+int queue_arm(Queue *queue);
+void queue_disarm(Queue *queue);
+void queue_finish(Queue *queue);
+int queue_finish_fd(Queue *queue);
 
 // Utility functions
 void get_timestamp(time_t *sec, long *msec);
+long long get_monotonic_ns();
+void sleep_until_ns(long long deadline);
 
 #endif //TENGINE_QUEUE_H
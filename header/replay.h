@@ -0,0 +1,130 @@
+#ifndef TENGINE_REPLAY_H
+#define TENGINE_REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "drawer.h"
+#include "event.h"
+#include "queue.h"
+
+// first bytes of a recording file
+#define RECORDING_MAGIC "CTREPLAY"
+// version of the recording file format; version 1 recordings, which have no clock records, and version 2 recordings,
+//  which have no resize records, can still be replayed
+#define RECORDING_VERSION 3
+// type of the records holding the time a frame advanced the game by (see drawer_on_clock); not an event type
+#define RECORD_CLOCK 0xff
+// replay modes (see init_replay)
+// REPLAY_REALTIME: frames are paced by the Drawer as usual, so the session is replayed at the speed it was played
+#define REPLAY_REALTIME 0
+// REPLAY_FAST: frames are drawn as fast as possible, e.g. to measure the cost of each frame
+#define REPLAY_FAST 1
+
+/* Defines the header of a recording file
+ * A recording file starts with this header, followed by a record for each event delivered to the game loop, in order:
+ *  - the number of frames published between the previous record and this one (unsigned LEB128)
+ *  - the time elapsed since the previous record (or the start of the recording), in nanoseconds (unsigned LEB128)
+ *  - the value of the event (zigzag-encoded signed LEB128)
+ *  - the type and the modifiers of the event (a byte each)
+ * Games run by engine_run also get a RECORD_CLOCK record in every frame, whose second field is the time the frame
+ *  advanced the game by instead, in nanoseconds, with a value and modifiers of 0
+ * The value of an EVENT_RESIZE record is the new size of the Display, as rows << 16 | columns, instead of RESIZE_EVENT
+ * Most records take 5 to 8 bytes
+ * char magic[8]: RECORDING_MAGIC
+ * uint32_t version: RECORDING_VERSION
+ * uint32_t reserved: 0
+ * int32_t rows, columns: size of the Display when the recording started; replays use the same size
+ * uint64_t seed: seed of the random number generator when the recording started (see rng.h)
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    int32_t rows;
+    int32_t columns;
+    uint64_t seed;
+} RecordingHeader;
+
+/* Defines a Recorder, which writes every event delivered to the game loop to a recording file, along with the frame it
+ *  was delivered in, so that the session can later be replayed exactly (see Replay); only the events of the Queue are
+ *  recorded, not the state of the actions (see InputState)
+ * Events are recorded when the game loop gets them from the Queue (see queue_set_observer), after the policies of their
+ *  values are applied, so a replay delivers the same events in the same frames; EVENT_RESIZE events are recorded in the
+ *  frame the Displays were resized in instead, with their new size, so a replay resizes them in the same frames (a
+ *  resize which leaves the size unchanged isn't recorded)
+ * The time each frame advanced the game by is recorded as well (see drawer_on_clock), so a game run by engine_run takes
+ *  the same simulation steps in every frame of the replay, and gets each event in the same step
+ * FILE *file: the recording file
+ * Drawer *drawer: the Drawer of the game, whose resizes are recorded as EVENT_RESIZE events
+ * unsigned long frame: number of frames published since the recording started
+ * unsigned long events: number of events recorded
+ * unsigned long _last_frame: frame of the last event recorded
+ * long long _start_ns: monotonic time (see get_monotonic_ns) at which the recording started
+ * long long _last_ns: monotonic time of the last event recorded
+ * int _rows, _columns: size of the Displays of the Drawer as last recorded
+ */
+typedef struct {
+    FILE *file;
+    Drawer *drawer;
+    unsigned long frame;
+    unsigned long events;
+    unsigned long _last_frame;
+    long long _start_ns;
+    long long _last_ns;
+    int _rows;
+    int _columns;
+} Recorder;
+
+/* Defines a Replay, which plays a recording file back in place of the KeyListener
+ * The events of each frame are placed in the Queue by the drawer thread itself (see drawer_on_frame) as soon as the
+ *  frame before it is published, so the game loop gets every event in the frame it got it in when it was recorded,
+ *  however fast frames are drawn; together with the seed of the random number generator, this makes the replay of a
+ *  deterministic game identical to the recorded session, as long as the game only reads its input from the Queue
+ * The state of the actions (see InputState) isn't recorded, since it follows the time keys were read at rather than
+ *  frames, and there is no KeyListener during a replay; games which poll input_is_down or input_is_held don't replay
+ *  exactly
+ * Replays don't need a terminal: the Displays get the size of the recording (see drawer_set_size), and are resized
+ *  along with the recorded EVENT_RESIZE events, in the frames the terminal was resized in; frames are presented to a
+ *  null backend, unless another backend than the terminal was set (see drawer_set_backend)
+ * FILE *file: the recording file
+ * Drawer *drawer, Queue *queue: the Drawer and Queue of the game
+ * int mode: REPLAY_REALTIME or REPLAY_FAST
+ * unsigned long frame: number of frames published since the replay started
+ * unsigned long events: number of events placed in the Queue
+ * long long elapsed_ns: time from the start to the end of the replay, set by replay_run
+ * int _has_next: set if _next holds the next record, read ahead of its frame
+ * unsigned long _next_frame: frame of the next record
+ * Event _next: event of the next record; for a RECORD_CLOCK record, time_ns holds the recorded time
+ * long long _clock_ns: recorded time the current frame advances the game by, or -1 if there is none (see
+ *  drawer_on_clock)
+ * int _ended: set once every record was replayed and EVENT_QUIT was placed in the Queue
+ * long long _start_ns: monotonic time at which the replay started
+ * Backend *_backend: the null backend set by the Replay, if it set one, else NULL
+ */
+typedef struct {
+    FILE *file;
+    Drawer *drawer;
+    Queue *queue;
+    int mode;
+    unsigned long frame;
+    unsigned long events;
+    long long elapsed_ns;
+    int _has_next;
+    unsigned long _next_frame;
+    Event _next;
+    long long _clock_ns;
+    int _ended;
+    long long _start_ns;
+    Backend *_backend;
+} Replay;
+
+// Recorder operations
+Recorder* init_recorder(const char *path, Drawer *drawer, Queue *queue);
+void delete_recorder(Recorder *recorder);
+
+// Replay operations
+Replay* init_replay(const char *path, Drawer *drawer, Queue *queue, int mode);
+void delete_replay(Replay *replay);
+void replay_run(Replay *replay);
+
+#endif //TENGINE_REPLAY_H
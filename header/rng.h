@@ -0,0 +1,18 @@
+#ifndef TENGINE_RNG_H
+#define TENGINE_RNG_H
+
+#include <stdint.h>
+
+/* Random number generator of the game
+ * Games should draw their random numbers from it rather than from rand(), so that a session can be replayed exactly:
+ *  its seed is saved by a Recorder and restored by a Replay before the game loop starts (see replay.h)
+ * The generator is a single xorshift64* state, meant to be used by the game loop thread only
+ */
+
+// RNG operations
+void rng_seed(uint64_t seed);
+uint64_t rng_get_seed();
+uint32_t rng_next();
+int rng_range(int n);
+
+#endif //TENGINE_RNG_H
@@ -0,0 +1,168 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../header/backend.h"
+
+/* Adds bytes to a checksum (FNV-1a)
+ * Return: the new checksum
+ */
+static uint64_t backend_hash(uint64_t hash, const void *bytes, size_t count) {
+    const unsigned char *p = bytes;
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Presents a frame by writing its encoded bytes to the file descriptor of the backend (terminal and file backends)
+ */
+static ssize_t backend_write(Backend *backend, const Display *display, Encoder *encoder) {
+    (void)display;
+    return encoder_submit(encoder, backend->fd);
+}
+
+/* Presents a frame by keeping a copy of its cells, in place of the oldest frame kept (memory backends)
+ */
+static ssize_t backend_keep(Backend *backend, const Display *display, Encoder *encoder) {
+    BackendFrame *frame = &backend->_frames[backend->frames % (unsigned long)backend->_capacity];
+    int cells = display->_rows * display->_columns;
+    if (cells > frame->_capacity) {
+        frame->cells = realloc(frame->cells, cells * sizeof(uint32_t));
+        frame->styles = realloc(frame->styles, cells * sizeof(uint32_t));
+        frame->_capacity = cells;
+    }
+    frame->frame = backend->frames + 1;
+    frame->rows = display->_rows;
+    frame->columns = display->_columns;
+    memcpy(frame->cells, display->_display_array, cells * sizeof(uint32_t));
+    memcpy(frame->styles, display->_style_array, cells * sizeof(uint32_t));
+    frame->bytes = encoder->_out_len;
+
+    uint64_t hash = BACKEND_CHECKSUM_SEED;
+    hash = backend_hash(hash, &frame->rows, sizeof(frame->rows));
+    hash = backend_hash(hash, &frame->columns, sizeof(frame->columns));
+    hash = backend_hash(hash, frame->cells, cells * sizeof(uint32_t));
+    hash = backend_hash(hash, frame->styles, cells * sizeof(uint32_t));
+    frame->checksum = hash;
+    backend->checksum = backend_hash(backend->checksum, &hash, sizeof(hash));
+    return (ssize_t)encoder->_out_len;
+}
+
+/* Presents a frame by discarding it (null backends)
+ */
+static ssize_t backend_discard(Backend *backend, const Display *display, Encoder *encoder) {
+    (void)backend;
+    (void)display;
+    return (ssize_t)encoder->_out_len;
+}
+
+/* Initializes a custom Backend, which presents frames by calling the given function
+ * ssize_t (*present)(Backend*, const Display*, Encoder*): called with each frame presented (see backend_present); the
+ *  encoded bytes of the frame are in the Encoder (see encoder_submit), and its cells in the Display
+ * void *ctx: kept in the Backend (backend->ctx), for the function to use
+ * Return: Pointer to the initialized Backend
+ */
+Backend* init_backend(ssize_t (*present)(Backend *backend, const Display *display, Encoder *encoder), void *ctx) {
+    Backend *new = malloc(sizeof(Backend));
+    new->type = BACKEND_CUSTOM;
+    new->present = present;
+    new->ctx = ctx;
+    new->every_frame = 0;
+    new->fd = -1;
+    new->frames = 0;
+    new->bytes = 0;
+    new->checksum = BACKEND_CHECKSUM_SEED;
+    new->_frames = NULL;
+    new->_capacity = 0;
+    return new;
+}
+
+/* Initializes a terminal Backend, which writes frames to stdout; every Drawer starts with one
+ * Return: Pointer to the initialized Backend
+ */
+Backend* init_terminal_backend() {
+    Backend *new = init_backend(backend_write, NULL);
+    new->type = BACKEND_TERMINAL;
+    new->fd = STDOUT_FILENO;
+    return new;
+}
+
+/* Initializes a memory Backend, which keeps the cells of the last frames presented, so that tests can check what was
+ *  drawn (see backend_frame), and a checksum of every frame presented (backend->checksum)
+ * Every frame published is presented to it, on the drawer thread, so two runs drawing the same frames get the same
+ *  checksum
+ * int frames: number of frames kept; at least 1
+ * Return: Pointer to the initialized Backend
+ */
+Backend* init_memory_backend(int frames) {
+    Backend *new = init_backend(backend_keep, NULL);
+    new->type = BACKEND_MEMORY;
+    new->every_frame = 1;
+    new->_capacity = frames > 0 ? frames : 1;
+    new->_frames = calloc(new->_capacity, sizeof(BackendFrame));
+    return new;
+}
+
+/* Initializes a file Backend, which writes frames to the file at the given path, as they would be written to the
+ *  terminal; the file can later be shown with cat
+ * Return: Pointer to the initialized Backend, or NULL if the file couldn't be created
+ */
+Backend* init_file_backend(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+    Backend *new = init_backend(backend_write, NULL);
+    new->type = BACKEND_FILE;
+    new->fd = fd;
+    return new;
+}
+
+/* Initializes a null Backend, which discards frames once they are encoded, so the whole render path except for the
+ *  write can be measured
+ * Return: Pointer to the initialized Backend
+ */
+Backend* init_null_backend() {
+    Backend *new = init_backend(backend_discard, NULL);
+    new->type = BACKEND_NULL;
+    return new;
+}
+
+/* Deletes a Backend, along with the frames it kept, and closes its file if it is a file backend
+ */
+void delete_backend(Backend *backend) {
+    if (backend->type == BACKEND_FILE) {
+        close(backend->fd);
+    }
+    for (int i = 0; i < backend->_capacity; ++i) {
+        free(backend->_frames[i].cells);
+        free(backend->_frames[i].styles);
+    }
+    free(backend->_frames);
+    free(backend);
+}
+
+/* Presents a frame which was just encoded by the given Encoder from the given Display
+ * Called by the Drawer, on its presenter thread (or on the drawer thread if the Backend gets every frame)
+ */
+void backend_present(Backend *backend, const Display *display, Encoder *encoder) {
+    ssize_t written = backend->present(backend, display, encoder);
+    ++backend->frames;
+    if (written > 0) {
+        backend->bytes += (unsigned long long)written;
+    }
+}
+
+/* Gets a frame kept by a memory backend
+ * Should only be called once the Drawer stopped presenting frames (e.g. after the drawer thread is joined)
+ * int age: 0 for the last frame presented, 1 for the one before it, and so on
+ * Return: Pointer to the frame, owned by the Backend, or NULL if it isn't kept (or the Backend isn't a memory backend)
+ */
+const BackendFrame* backend_frame(const Backend *backend, int age) {
+    if (backend->type != BACKEND_MEMORY || age < 0 || age >= backend->_capacity ||
+        (unsigned long)age >= backend->frames) {
+        return NULL;
+    }
+    return &backend->_frames[(backend->frames - 1 - (unsigned long)age) % (unsigned long)backend->_capacity];
+}
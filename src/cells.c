@@ -0,0 +1,240 @@
+#include "../header/cells.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CELLS_X86
+#endif
+
+/* Scalar version of cells_fill
+ */
+static void cells_fill_scalar(uint32_t *dst, uint32_t value, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = value;
+    }
+}
+
+/* Scalar version of cells_blit
+ */
+static void cells_blit_scalar(uint32_t *dst, const uint32_t *src, int count, uint32_t key) {
+    for (int i = 0; i < count; ++i) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+/* Scalar version of cells_blit_styled
+ */
+static void cells_blit_styled_scalar(uint32_t *dst, uint32_t *dst_style, const uint32_t *src,
+                                     const uint32_t *src_style, int count, uint32_t key) {
+    for (int i = 0; i < count; ++i) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+            dst_style[i] = src_style[i];
+        }
+    }
+}
+
+#ifdef CELLS_X86
+#ifdef __SSE2__
+/* SSE2 version of cells_fill, storing 4 cells at a time
+ */
+static void cells_fill_sse2(uint32_t *dst, uint32_t value, int count) {
+    __m128i v = _mm_set1_epi32((int)value);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)&dst[i], v);
+    }
+    cells_fill_scalar(&dst[i], value, count - i);
+}
+
+/* SSE2 version of cells_blit, handling 4 cells at a time
+ * Cells equal to the key keep their destination value, the rest are replaced by the source cells
+ */
+static void cells_blit_sse2(uint32_t *dst, const uint32_t *src, int count, uint32_t key) {
+    __m128i k = _mm_set1_epi32((int)key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i transparent = _mm_cmpeq_epi32(s, k);
+        d = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        _mm_storeu_si128((__m128i *)&dst[i], d);
+    }
+    cells_blit_scalar(&dst[i], &src[i], count - i, key);
+}
+
+/* SSE2 version of cells_blit_styled, handling 4 cells at a time
+ * The mask of transparent cells is computed once from the glyphs and applied to both planes
+ */
+static void cells_blit_styled_sse2(uint32_t *dst, uint32_t *dst_style, const uint32_t *src,
+                                   const uint32_t *src_style, int count, uint32_t key) {
+    __m128i k = _mm_set1_epi32((int)key);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i ss = _mm_loadu_si128((const __m128i *)&src_style[i]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i ds = _mm_loadu_si128((const __m128i *)&dst_style[i]);
+        __m128i transparent = _mm_cmpeq_epi32(s, k);
+        d = _mm_or_si128(_mm_and_si128(transparent, d), _mm_andnot_si128(transparent, s));
+        ds = _mm_or_si128(_mm_and_si128(transparent, ds), _mm_andnot_si128(transparent, ss));
+        _mm_storeu_si128((__m128i *)&dst[i], d);
+        _mm_storeu_si128((__m128i *)&dst_style[i], ds);
+    }
+    cells_blit_styled_scalar(&dst[i], &dst_style[i], &src[i], &src_style[i], count - i, key);
+}
+#endif
+
+/* AVX2 version of cells_fill, storing 8 cells at a time
+ */
+__attribute__((target("avx2")))
+static void cells_fill_avx2(uint32_t *dst, uint32_t value, int count) {
+    __m256i v = _mm256_set1_epi32((int)value);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i *)&dst[i], v);
+    }
+    cells_fill_scalar(&dst[i], value, count - i);
+}
+
+/* AVX2 version of cells_blit, handling 8 cells at a time
+ */
+__attribute__((target("avx2")))
+static void cells_blit_avx2(uint32_t *dst, const uint32_t *src, int count, uint32_t key) {
+    __m256i k = _mm256_set1_epi32((int)key);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        d = _mm256_blendv_epi8(s, d, _mm256_cmpeq_epi32(s, k));
+        _mm256_storeu_si256((__m256i *)&dst[i], d);
+    }
+    cells_blit_scalar(&dst[i], &src[i], count - i, key);
+}
+
+/* AVX2 version of cells_blit_styled, handling 8 cells at a time
+ */
+__attribute__((target("avx2")))
+static void cells_blit_styled_avx2(uint32_t *dst, uint32_t *dst_style, const uint32_t *src,
+                                   const uint32_t *src_style, int count, uint32_t key) {
+    __m256i k = _mm256_set1_epi32((int)key);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i ss = _mm256_loadu_si256((const __m256i *)&src_style[i]);
+        __m256i d = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i ds = _mm256_loadu_si256((const __m256i *)&dst_style[i]);
+        __m256i transparent = _mm256_cmpeq_epi32(s, k);
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_blendv_epi8(s, d, transparent));
+        _mm256_storeu_si256((__m256i *)&dst_style[i], _mm256_blendv_epi8(ss, ds, transparent));
+    }
+    cells_blit_styled_scalar(&dst[i], &dst_style[i], &src[i], &src_style[i], count - i, key);
+}
+#endif
+
+// version of the kernels chosen with cells_set_kernels
+static int cells_kernels = CELLS_AUTO;
+
+/* Chooses the version of the kernels used by every following call, e.g. to compare each version with the others
+ * int kernels: CELLS_AUTO (default), CELLS_AVX2, CELLS_SSE2 or CELLS_SCALAR
+ * Return: 0 if successful, or 1 if the CPU (or the architecture the engine was built for) doesn't support the version
+ */
+int cells_set_kernels(int kernels) {
+    switch (kernels) {
+        case CELLS_AUTO:
+        case CELLS_SCALAR:
+            break;
+#ifdef CELLS_X86
+        case CELLS_AVX2:
+            if (!__builtin_cpu_supports("avx2")) {
+                return 1;
+            }
+            break;
+#ifdef __SSE2__
+        case CELLS_SSE2:
+            break;
+#endif
+#endif
+        default:
+            return 1;
+    }
+    cells_kernels = kernels;
+    return 0;
+}
+
+/* Gets the version of the kernels to run: the one chosen with cells_set_kernels, or else the best one the CPU supports
+ */
+static int cells_active() {
+    if (cells_kernels != CELLS_AUTO) {
+        return cells_kernels;
+    }
+#ifdef CELLS_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return CELLS_AVX2;
+    }
+#ifdef __SSE2__
+    return CELLS_SSE2;
+#endif
+#endif
+    return CELLS_SCALAR;
+}
+
+/* Sets count consecutive cells starting at dst to the given value
+ */
+void cells_fill(uint32_t *dst, uint32_t value, int count) {
+    switch (cells_active()) {
+#ifdef CELLS_X86
+        case CELLS_AVX2:
+            cells_fill_avx2(dst, value, count);
+            return;
+#ifdef __SSE2__
+        case CELLS_SSE2:
+            cells_fill_sse2(dst, value, count);
+            return;
+#endif
+#endif
+        default:
+            cells_fill_scalar(dst, value, count);
+    }
+}
+
+/* Copies count consecutive cells from src to dst, skipping the source cells equal to key (transparent cells)
+ */
+void cells_blit(uint32_t *dst, const uint32_t *src, int count, uint32_t key) {
+    switch (cells_active()) {
+#ifdef CELLS_X86
+        case CELLS_AVX2:
+            cells_blit_avx2(dst, src, count, key);
+            return;
+#ifdef __SSE2__
+        case CELLS_SSE2:
+            cells_blit_sse2(dst, src, count, key);
+            return;
+#endif
+#endif
+        default:
+            cells_blit_scalar(dst, src, count, key);
+    }
+}
+
+/* Copies count consecutive cells from src to dst along with their styles (src_style to dst_style), skipping the source
+ *  cells whose glyph is equal to key; a transparent cell keeps both the glyph and the style of the destination
+ */
+void cells_blit_styled(uint32_t *dst, uint32_t *dst_style, const uint32_t *src, const uint32_t *src_style, int count,
+                       uint32_t key) {
+    switch (cells_active()) {
+#ifdef CELLS_X86
+        case CELLS_AVX2:
+            cells_blit_styled_avx2(dst, dst_style, src, src_style, count, key);
+            return;
+#ifdef __SSE2__
+        case CELLS_SSE2:
+            cells_blit_styled_sse2(dst, dst_style, src, src_style, count, key);
+            return;
+#endif
+#endif
+        default:
+            cells_blit_styled_scalar(dst, dst_style, src, src_style, count, key);
+    }
+}
@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../header/compositor.h"
+#include "../header/cells.h"
+
+/* Allocates the damage history of a Compositor for its current size
+ * Nothing is marked as damaged; frames composed before the history was allocated are stale anyway (see _resize_frame)
+ */
+static void compositor_alloc_history(Compositor *compositor) {
+    for (int h = 0; h < DAMAGE_HISTORY; ++h) {
+        free(compositor->_history_rows[h]);
+        free(compositor->_history_start[h]);
+        free(compositor->_history_end[h]);
+        compositor->_history_rows[h] = calloc(DIRTY_WORDS(compositor->_rows), sizeof(uint64_t));
+        compositor->_history_start[h] = malloc(compositor->_rows*sizeof(int));
+        compositor->_history_end[h] = malloc(compositor->_rows*sizeof(int));
+    }
+}
+
+/* Initializes a new Compositor, without any layer
+ * int rows, columns: size of the layers, which should match the size of the Displays composed into
+ * Return: Pointer to the initialized Compositor
+ */
+Compositor* init_compositor(int rows, int columns) {
+    Compositor *new = malloc(sizeof(Compositor));
+    new->layer_count = 0;
+    new->_rows = rows;
+    new->_columns = columns;
+    for (int h = 0; h < DAMAGE_HISTORY; ++h) {
+        new->_history_rows[h] = NULL;
+        new->_history_start[h] = NULL;
+        new->_history_end[h] = NULL;
+    }
+    compositor_alloc_history(new);
+    new->frame = 0;
+    new->_resize_frame = 0;
+
+    return new;
+}
+
+/* Deletes a Compositor, including its layers
+ */
+void delete_compositor(Compositor *compositor) {
+    for (int l = 0; l < compositor->layer_count; ++l) {
+        delete_display(compositor->layers[l]);
+    }
+    for (int h = 0; h < DAMAGE_HISTORY; ++h) {
+        free(compositor->_history_rows[h]);
+        free(compositor->_history_start[h]);
+        free(compositor->_history_end[h]);
+    }
+    free(compositor);
+}
+
+/* Adds a new layer on top of the existing layers of a Compositor
+ * The layer starts fully transparent; it is owned by the Compositor, and deleted along with it
+ * Return: Pointer to the layer, or NULL if the Compositor already has MAX_LAYERS layers
+ */
+Display* compositor_add_layer(Compositor *compositor) {
+    if (compositor->layer_count == MAX_LAYERS) {
+        return NULL;
+    }
+
+    Display *layer = init_layer();
+    display_resize(layer, compositor->_rows, compositor->_columns);
+    compositor->layers[compositor->layer_count++] = layer;
+    return layer;
+}
+
+/* Resizes every layer of a Compositor (see display_resize)
+ * Every target is recomposed entirely the next time it is composed into
+ */
+void compositor_resize(Compositor *compositor, int rows, int columns) {
+    if (rows == compositor->_rows && columns == compositor->_columns) {
+        return;
+    }
+
+    for (int l = 0; l < compositor->layer_count; ++l) {
+        display_resize(compositor->layers[l], rows, columns);
+    }
+    compositor->_rows = rows;
+    compositor->_columns = columns;
+    compositor_alloc_history(compositor);
+    compositor->_resize_frame = compositor->frame;
+}
+
+/* Composes the columns [start, end) of a row of the target
+ * The row is reset to whitespace with STYLE_DEFAULT, then each layer is blitted over it from bottom to top, skipping its
+ *  transparent cells (see cells_blit_styled); the row stays in cache while every layer is applied to it
+ */
+static void compositor_compose_row(const Compositor *compositor, Display *target, int row, int start, int end) {
+    int index = row*compositor->_columns + start;
+    int count = end - start;
+    cells_fill(&target->_display_array[index], target->empty, count);
+    cells_fill(&target->_style_array[index], STYLE_DEFAULT, count);
+    for (int l = 0; l < compositor->layer_count; ++l) {
+        const Display *layer = compositor->layers[l];
+        cells_blit_styled(&target->_display_array[index], &target->_style_array[index], &layer->_display_array[index],
+                          &layer->_style_array[index], count, GLYPH_NONE);
+    }
+}
+
+/* Composes the layers of a Compositor into the target Display
+ * The damage of every layer since the last frame composed is gathered into the damage of this frame, and the layers'
+ *  damage is reset
+ * unsigned long *composed: the frame the target was last composed at (its value of compositor->frame), or 0 if it was
+ *  never composed into; updated to the current frame
+ * Only the cells damaged in any frame composed after the target was last composed are recomposed; the target is
+ *  recomposed entirely if it was never composed, if that was more than DAMAGE_HISTORY frames ago, or if the layers were
+ *  resized since then (the target is resized to the size of the layers if needed)
+ * The dirty ranges of the target are replaced by the damage of this frame, which covers every cell differing from the
+ *  frame composed previously; the Encoder relies on them to only visit changed cells, so a composed target shouldn't be
+ *  drawn onto or cleared directly
+ */
+void compositor_compose(Compositor *compositor, Display *target, unsigned long *composed) {
+    int rows = compositor->_rows;
+    int columns = compositor->_columns;
+    unsigned long frame = ++compositor->frame;
+    uint64_t *damage_rows = compositor->_history_rows[frame % DAMAGE_HISTORY];
+    int *damage_start = compositor->_history_start[frame % DAMAGE_HISTORY];
+    int *damage_end = compositor->_history_end[frame % DAMAGE_HISTORY];
+
+    // gather the damage of every layer into the damage of this frame
+    memset(damage_rows, 0, DIRTY_WORDS(rows)*sizeof(uint64_t));
+    for (int l = 0; l < compositor->layer_count; ++l) {
+        Display *layer = compositor->layers[l];
+        for (int w = 0; w < DIRTY_WORDS(rows); ++w) {
+            uint64_t word = layer->_damage_rows[w];
+            while (word) {
+                int i = w * DIRTY_WORD_BITS + __builtin_ctzll(word);
+                word &= word - 1;
+                uint64_t bit = (uint64_t)1 << (i % DIRTY_WORD_BITS);
+                if (!(damage_rows[w] & bit)) {
+                    damage_rows[w] |= bit;
+                    damage_start[i] = layer->_damage_start[i];
+                    damage_end[i] = layer->_damage_end[i];
+                    continue;
+                }
+                if (layer->_damage_start[i] < damage_start[i]) {
+                    damage_start[i] = layer->_damage_start[i];
+                }
+                if (layer->_damage_end[i] > damage_end[i]) {
+                    damage_end[i] = layer->_damage_end[i];
+                }
+            }
+        }
+        display_reset_damage(layer);
+    }
+
+    int full = *composed == 0 || *composed <= compositor->_resize_frame || frame - *composed > DAMAGE_HISTORY ||
+               target->_rows != rows || target->_columns != columns;
+    display_resize(target, rows, columns);
+
+    // recompose the union of the damage of every frame the target missed, including this one
+    for (int w = 0; w < DIRTY_WORDS(rows); ++w) {
+        uint64_t word = full ? ~(uint64_t)0 : 0;
+        for (unsigned long n = *composed + 1; !full && n <= frame; ++n) {
+            word |= compositor->_history_rows[n % DAMAGE_HISTORY][w];
+        }
+        while (word) {
+            int i = w * DIRTY_WORD_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            if (i >= rows) {
+                break;
+            }
+
+            int start = 0;
+            int end = columns;
+            if (!full) {
+                start = columns;
+                end = 0;
+                for (unsigned long n = *composed + 1; n <= frame; ++n) {
+                    int h = n % DAMAGE_HISTORY;
+                    if (!((compositor->_history_rows[h][w] >> (i % DIRTY_WORD_BITS)) & 1)) {
+                        continue;
+                    }
+                    if (compositor->_history_start[h][i] < start) {
+                        start = compositor->_history_start[h][i];
+                    }
+                    if (compositor->_history_end[h][i] > end) {
+                        end = compositor->_history_end[h][i];
+                    }
+                }
+            }
+            compositor_compose_row(compositor, target, i, start, end);
+        }
+    }
+
+    // the target now differs from the frame composed before it only within the damage of this frame
+    memset(target->_dirty_rows, 0, DIRTY_WORDS(rows)*sizeof(uint64_t));
+    for (int i = 0; i < rows; ++i) {
+        uint64_t bit = (uint64_t)1 << (i % DIRTY_WORD_BITS);
+        if (full || (damage_rows[i / DIRTY_WORD_BITS] & bit)) {
+            target->_dirty_rows[i / DIRTY_WORD_BITS] |= bit;
+            target->_dirty_start[i] = full ? 0 : damage_start[i];
+            target->_dirty_end[i] = full ? columns : damage_end[i];
+        }
+        else {
+            target->_dirty_start[i] = columns;
+            target->_dirty_end[i] = 0;
+        }
+    }
+    *composed = frame;
+}
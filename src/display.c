@@ -3,23 +3,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../header/display.h"
+#include "../header/cells.h"
 
 /* Initializes a new Display
- * The display size is initialized to the terminal's current size (in rows, columns)
+ * The display size is initialized to the terminal's current size (in rows, columns), or 0x0 if it can't be determined
  * The display array is allocated to the size 4*rows*columns, since it is a table of size rows*columns with CELLBYTES bytes per cell
- * TODO: Currently, resizing the terminal window while the engine is running is not supported
+ * Every cell starts empty, holding the glyph id of the whitespace character
+ * The Display can later be resized with display_resize (the Drawer does so when the terminal is resized)
  * Return: Pointer to the initialized Display
  */
 Display* init_display() {
     Display *new = malloc(sizeof(Display));
+    new->_rows = 0;
+    new->_columns = 0;
+    new->_display_array = NULL;
+    new->_style_array = NULL;
+    new->_dirty_rows = NULL;
+    new->_dirty_start = NULL;
+    new->_dirty_end = NULL;
+    new->_damage_rows = NULL;
+    new->_damage_start = NULL;
+    new->_damage_end = NULL;
+
+    new->empty = ' ';
+
     display_update_size(new);
-    // display array is table of size
-    new->_display_array = malloc(new->_rows*new->_columns*sizeof(char)*CELLBYTES);
 
-    new->empty[0] = ' ';
-    for (int i = 1; i < CELLBYTES; ++i) {
-        new->empty[i] = '\0';
-    }
+    return new;
+}
+
+/* Initializes a new Display to be used as a layer of a Compositor (see compositor.h)
+ * Same as init_display, except that the empty value is GLYPH_NONE: every cell starts transparent, and display_clear
+ *  makes cells transparent again instead of setting them to a whitespace character
+ * Return: Pointer to the initialized Display
+ */
+Display* init_layer() {
+    Display *new = init_display();
+    new->empty = GLYPH_NONE;
+    cells_fill(new->_display_array, new->empty, new->_rows*new->_columns);
 
     return new;
 }
@@ -29,26 +50,112 @@ Display* init_display() {
  */
 void delete_display(Display *display) {
     free(display->_display_array);
+    free(display->_style_array);
+    free(display->_dirty_rows);
+    free(display->_dirty_start);
+    free(display->_dirty_end);
+    free(display->_damage_rows);
+    free(display->_damage_start);
+    free(display->_damage_end);
     free(display);
 }
 
+/* Gets the current size of the terminal
+ * This performs a system call, so it shouldn't be used on every frame
+ * Return: 0 if successful, else -1 (e.g. stdout is not a terminal), in which case rows and columns are left unchanged
+ */
+int terminal_get_size(int *rows, int *columns) {
+    struct winsize w;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
+        return -1;
+    }
+
+    *rows = w.ws_row;
+    *columns = w.ws_col;
+    return 0;
+}
+
 /* Updates the Display size by getting the current terminal size
- * This currently doesn't affect the display array, meaning this function should only be used by init_display
+ * The Display is resized accordingly (see display_resize)
+ * If the size can't be determined (e.g. stdout is not a terminal), the size is left unchanged
  */
 void display_update_size(Display *display) {
-    struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+    int rows = display->_rows;
+    int columns = display->_columns;
+    if (terminal_get_size(&rows, &columns) == -1 && display->_display_array != NULL) {
+        return;
+    }
+
+    display_resize(display, rows, columns);
+}
+
+/* Resizes a Display to the given number of rows and columns
+ * Everything is reallocated at once; the part of the previous contents which fits in the new size is preserved (along
+ *  with its dirty ranges), and every new cell is empty
+ * The whole Display is marked as damaged, since cells no longer are where they were
+ */
+void display_resize(Display *display, int rows, int columns) {
+    if (display->_display_array != NULL && rows == display->_rows && columns == display->_columns) {
+        return;
+    }
+
+    uint32_t *cells = malloc((size_t)rows*columns*CELLBYTES);
+    uint32_t *styles = calloc((size_t)rows*columns, sizeof(uint32_t));
+    uint64_t *dirty_rows = calloc(DIRTY_WORDS(rows), sizeof(uint64_t));
+    int *dirty_start = malloc(rows*sizeof(int));
+    int *dirty_end = malloc(rows*sizeof(int));
+    uint64_t *damage_rows = calloc(DIRTY_WORDS(rows), sizeof(uint64_t));
+    int *damage_start = calloc(rows, sizeof(int));
+    int *damage_end = malloc(rows*sizeof(int));
+
+    cells_fill(cells, display->empty, rows*columns);
+    for (int i = 0; i < rows; ++i) {
+        dirty_start[i] = columns;
+        dirty_end[i] = 0;
+        damage_rows[i / DIRTY_WORD_BITS] |= (uint64_t)1 << (i % DIRTY_WORD_BITS);
+        damage_end[i] = columns;
+    }
+
+    // copy the overlapping part of the previous contents; every cell outside it was empty or is cut off
+    int keep_rows = rows < display->_rows ? rows : display->_rows;
+    int keep_columns = columns < display->_columns ? columns : display->_columns;
+    for (int i = 0; i < keep_rows && keep_columns > 0; ++i) {
+        if (!display_row_dirty(display, i) || display->_dirty_start[i] >= keep_columns) {
+            continue;
+        }
+        memcpy(&cells[i*columns], &display->_display_array[i*display->_columns], (size_t)keep_columns*CELLBYTES);
+        memcpy(&styles[i*columns], &display->_style_array[i*display->_columns], keep_columns*sizeof(uint32_t));
+        dirty_rows[i / DIRTY_WORD_BITS] |= (uint64_t)1 << (i % DIRTY_WORD_BITS);
+        dirty_start[i] = display->_dirty_start[i];
+        dirty_end[i] = display->_dirty_end[i] < keep_columns ? display->_dirty_end[i] : keep_columns;
+    }
 
-    display->_rows = w.ws_row;
-    display->_columns = w.ws_col;
+    free(display->_display_array);
+    free(display->_style_array);
+    free(display->_dirty_rows);
+    free(display->_dirty_start);
+    free(display->_dirty_end);
+    free(display->_damage_rows);
+    free(display->_damage_start);
+    free(display->_damage_end);
+    display->_display_array = cells;
+    display->_style_array = styles;
+    display->_dirty_rows = dirty_rows;
+    display->_dirty_start = dirty_start;
+    display->_dirty_end = dirty_end;
+    display->_damage_rows = damage_rows;
+    display->_damage_start = damage_start;
+    display->_damage_end = damage_end;
+    display->_rows = rows;
+    display->_columns = columns;
 }
 
 /* Gets the current display size of a Display
+ * This doesn't query the terminal; the Drawer resizes its Displays when the terminal is resized
  * Returns: int[2] containing rows ([0]) and columns ([1])
  * The returned value is dynamically allocated and should be freed when it is no longer needed
  */
 int* display_get_size(Display *display) {
-    display_update_size(display);
     int *size = malloc(2*sizeof(int));
     size[0] = display->_rows;
     size[1] = display->_columns;
@@ -56,55 +163,291 @@ int* display_get_size(Display *display) {
     return size;
 }
 
+/* Gets the number of rows of a Display
+ * Unlike display_get_size, this doesn't allocate anything, so it can be used on every frame
+ */
+int display_rows(const Display *display) {
+    return display->_rows;
+}
+
+/* Gets the number of columns of a Display
+ * Unlike display_get_size, this doesn't allocate anything, so it can be used on every frame
+ */
+int display_cols(const Display *display) {
+    return display->_columns;
+}
+
+/* Marks the columns [start, end) of the given row of a Display as damaged
+ */
+static inline void display_mark_damage(Display *display, int row, int start, int end) {
+    display->_damage_rows[row / DIRTY_WORD_BITS] |= (uint64_t)1 << (row % DIRTY_WORD_BITS);
+    if (start < display->_damage_start[row]) {
+        display->_damage_start[row] = start;
+    }
+    if (end > display->_damage_end[row]) {
+        display->_damage_end[row] = end;
+    }
+}
+
+/* Marks the columns [start, end) of the given row of a Display as dirty (and damaged)
+ */
+static inline void display_mark_dirty(Display *display, int row, int start, int end) {
+    display->_dirty_rows[row / DIRTY_WORD_BITS] |= (uint64_t)1 << (row % DIRTY_WORD_BITS);
+    if (start < display->_dirty_start[row]) {
+        display->_dirty_start[row] = start;
+    }
+    if (end > display->_dirty_end[row]) {
+        display->_dirty_end[row] = end;
+    }
+    display_mark_damage(display, row, start, end);
+}
+
 /* Clears a Display
- * This corresponds to replacing every existing character in the display with a whitespace character
+ * This corresponds to replacing every existing character in the display with a whitespace character, and resetting
+ *  every style to STYLE_DEFAULT
+ * Only the dirty ranges of the dirty rows are reset, since every other cell already holds a whitespace character; the
+ *  cost of clearing therefore depends on how much was drawn since the last clear, not on the size of the Display
  */
 void display_clear(Display *display) {
-    display_update_size(display);
-    for (int i = 0; i < display->_rows; ++i) {
-        for (int j = 0; j < display->_columns; ++j) {
-            display_set_exact(display, i, j, display->empty);
+    for (int w = 0; w < DIRTY_WORDS(display->_rows); ++w) {
+        uint64_t word = display->_dirty_rows[w];
+        while (word) {
+            int i = w * DIRTY_WORD_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            int index = i*display->_columns + display->_dirty_start[i];
+            int count = display->_dirty_end[i] - display->_dirty_start[i];
+            cells_fill(&display->_display_array[index], display->empty, count);
+            cells_fill(&display->_style_array[index], STYLE_DEFAULT, count);
+            display_mark_damage(display, i, display->_dirty_start[i], display->_dirty_end[i]);
+            display->_dirty_start[i] = display->_columns;
+            display->_dirty_end[i] = 0;
+        }
+        display->_dirty_rows[w] = 0;
+    }
+}
+
+/* Checks whether any cell of the given row of a Display was set since the last clear
+ * Return: 1 if the row is dirty, else 0
+ */
+int display_row_dirty(const Display *display, int row) {
+    return (display->_dirty_rows[row / DIRTY_WORD_BITS] >> (row % DIRTY_WORD_BITS)) & 1;
+}
+
+/* Resets the damaged ranges of a Display, so that only cells changed from now on are considered damaged
+ * Called by the Compositor once it has recomposed the damaged parts of a layer
+ */
+void display_reset_damage(Display *display) {
+    for (int w = 0; w < DIRTY_WORDS(display->_rows); ++w) {
+        uint64_t word = display->_damage_rows[w];
+        while (word) {
+            int i = w * DIRTY_WORD_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            display->_damage_start[i] = display->_columns;
+            display->_damage_end[i] = 0;
         }
+        display->_damage_rows[w] = 0;
     }
 }
 
+/* Gets the style of the cell at the given position of a Display
+ * Return: the style of the cell (see STYLE_DEFAULT)
+ */
+uint32_t display_get_style(Display *display, int row, int column) {
+    return display->_style_array[row*display->_columns + column];
+}
+
+/* Sets the style of the cell at the given position of a Display, leaving its character unchanged
+ * uint32_t style: the style to use, built from the STYLE_ macros of display.h
+ */
+void display_set_style(Display *display, int row, int column, uint32_t style) {
+    display_mark_dirty(display, row, column, column + 1);
+    display->_style_array[row*display->_columns + column] = style;
+}
+
+/* Sets both the character and the style of the cell at the given position of a Display
+ * Same as display_set followed by display_set_style
+ */
+void display_set_styled(Display *display, int row, int column, const char *c, uint32_t style) {
+    display_set_id_styled(display, row, column, glyph_intern(c, CELLBYTES), style);
+}
+
+/* Sets both the glyph id and the style of the cell at the given position of a Display
+ * Same as display_set_id followed by display_set_style
+ */
+void display_set_id_styled(Display *display, int row, int column, uint32_t id, uint32_t style) {
+    display_mark_dirty(display, row, column, column + 1);
+    display->_display_array[row*display->_columns + column] = id;
+    display->_style_array[row*display->_columns + column] = style;
+}
+
 /* Gets the character at the given position of a Display
- * The returned value should be freed after use
- * Return: char* of size CELLBYTES containing character(s) at cell
+ * The returned value should be freed after use; display_get_id should be preferred, since it doesn't allocate
+ * Return: '\0'-terminated char* containing the UTF-8 bytes of the character at cell, padded with '\0' to at least
+ *  CELLBYTES bytes
  */
 char* display_get(Display *display, int row, int column) {
-    char *res = malloc(CELLBYTES*sizeof(char));
-    memcpy(res, &display->_display_array[CELLBYTES*(row*display->_columns + column)], CELLBYTES);
+    char *res = calloc(GLYPH_MAX_BYTES + 1, sizeof(char));
+    glyph_encode(res, display->_display_array[row*display->_columns + column]);
     return res;
 }
 
+/* Gets the glyph id of the cell at the given position of a Display
+ * Return: the glyph id of the cell (see display_intern)
+ */
+uint32_t display_get_id(const Display *display, int row, int column) {
+    return display->_display_array[row*display->_columns + column];
+}
+
 /* Sets the character at the given position of a Display to the given value
  * const char *c: Should be a char array of size CELLBYTES or less; if it is longer, only up to CELLBYTES are used
  *  only single characters should be contained in the array (including those that require more than 1 byte for representation)
+ * The character is interned on every call (see glyph_intern); for characters drawn on every frame, the id returned by
+ *  display_intern should be kept and used with display_set_id instead
  */
 void display_set(Display *display, int row, int column, const char *c) {
-    int end_index = -1;
-    for (int i = 0; i < CELLBYTES; ++i) {
-        if (c[i] == '\0') {
-            end_index = i;
-            break;
-        }
+    display_set_id(display, row, column, glyph_intern(c, CELLBYTES));
+}
+
+/* Same as display_set
+ * Kept for compatibility: c used to have to be exactly CELLBYTES in length, padded with '\0' characters if necessary,
+ *  which is still accepted
+ */
+void display_set_exact(Display *display, int row, int column, const char *c) {
+    display_set_id(display, row, column, glyph_intern(c, CELLBYTES));
+}
+
+/* Sets the cell at the given position of a Display to the given glyph id
+ * uint32_t id: a glyph id returned by display_intern
+ */
+void display_set_id(Display *display, int row, int column, uint32_t id) {
+    display_mark_dirty(display, row, column, column + 1);
+    display->_display_array[row*display->_columns + column] = id;
+}
+
+/* Clips a rectangle to the bounds of a Display
+ * The rectangle starts at (*row, *column) and is *height rows by *width columns; all four are adjusted so that only the
+ *  part within the Display remains
+ * int *skip_rows, *skip_columns: set to the number of rows and columns cut from the top and left of the rectangle; may
+ *  be NULL if not needed
+ * Return: 1 if any part of the rectangle is within the Display, else 0
+ */
+static int display_clip(const Display *display, int *row, int *column, int *height, int *width,
+                        int *skip_rows, int *skip_columns) {
+    int top = *row < 0 ? -*row : 0;
+    int left = *column < 0 ? -*column : 0;
+    *row += top;
+    *column += left;
+    *height -= top;
+    *width -= left;
+    if (*row + *height > display->_rows) {
+        *height = display->_rows - *row;
+    }
+    if (*column + *width > display->_columns) {
+        *width = display->_columns - *column;
+    }
+    if (skip_rows != NULL) {
+        *skip_rows = top;
+    }
+    if (skip_columns != NULL) {
+        *skip_columns = left;
+    }
+    return *height > 0 && *width > 0;
+}
+
+/* Sets every cell of a rectangle of a Display to the given glyph id
+ * The rectangle starts at the given row and column and spans height rows and width columns; parts of it outside the
+ *  Display are ignored
+ * Each row of the rectangle is filled by a vectorized kernel (see cells_fill)
+ */
+void display_fill_rect(Display *display, int row, int column, int height, int width, uint32_t id) {
+    if (!display_clip(display, &row, &column, &height, &width, NULL, NULL)) {
+        return;
+    }
+    for (int i = row; i < row + height; ++i) {
+        cells_fill(&display->_display_array[i*display->_columns + column], id, width);
+        display_mark_dirty(display, i, column, column + width);
+    }
+}
+
+/* Draws a horizontal line of length cells with the given glyph id on a Display, starting at the given row and column
+ *  and extending right
+ */
+void display_hline(Display *display, int row, int column, int length, uint32_t id) {
+    display_fill_rect(display, row, column, 1, length, id);
+}
+
+/* Draws a vertical line of length cells with the given glyph id on a Display, starting at the given row and column and
+ *  extending down
+ */
+void display_vline(Display *display, int row, int column, int length, uint32_t id) {
+    int width = 1;
+    if (!display_clip(display, &row, &column, &length, &width, NULL, NULL)) {
+        return;
+    }
+    for (int i = row; i < row + length; ++i) {
+        display->_display_array[i*display->_columns + column] = id;
+        display_mark_dirty(display, i, column, column + 1);
     }
+}
 
-    if (end_index == -1 || end_index == CELLBYTES - 1) {
-        memcpy(&display->_display_array[CELLBYTES*(row*display->_columns+column)], c, CELLBYTES*sizeof(char));
+/* Copies a rectangular buffer of cells onto a Display, with its top left cell placed at the given row and column
+ * const uint32_t *cells: height*width glyph ids, stored row by row in the same layout as the display array
+ * uint32_t transparent: cells of the buffer holding this glyph id are not copied, so the Display keeps its own value
+ *  there; GLYPH_NONE can be used if the buffer has no transparent cells
+ * Parts of the buffer which fall outside the Display are ignored
+ * Each row of the buffer is copied by a vectorized kernel (see cells_blit)
+ */
+void display_blit(Display *display, int row, int column, int height, int width, const uint32_t *cells,
+                  uint32_t transparent) {
+    int stride = width;
+    int skip_rows, skip_columns;
+    if (!display_clip(display, &row, &column, &height, &width, &skip_rows, &skip_columns)) {
         return;
     }
+    for (int i = 0; i < height; ++i) {
+        cells_blit(&display->_display_array[(row + i)*display->_columns + column],
+                   &cells[(skip_rows + i)*stride + skip_columns], width, transparent);
+        display_mark_dirty(display, row + i, column, column + width);
+    }
+}
+
+/* Sets scattered cells of a Display to the given glyph ids, e.g. to draw many entities at once (see entities_render)
+ * const int *rows, *columns: row and column of each cell
+ * const uint32_t *ids: glyph id of each cell
+ * Cells outside the Display are ignored; later cells overwrite earlier ones at the same position
+ */
+void display_set_cells(Display *display, const int *rows, const int *columns, const uint32_t *ids, int count) {
+    for (int i = 0; i < count; ++i) {
+        int row = rows[i];
+        int column = columns[i];
+        if ((unsigned int)row >= (unsigned int)display->_rows || (unsigned int)column >= (unsigned int)display->_columns) {
+            continue;
+        }
+        display->_display_array[row*display->_columns + column] = ids[i];
+        display_mark_dirty(display, row, column, column + 1);
+    }
+}
 
-    int index = CELLBYTES * (row * display->_columns + column);
-    memcpy(&display->_display_array[index], c, end_index*sizeof(char));
-    memset(&display->_display_array[index + end_index], '\0', (CELLBYTES - end_index)*sizeof(char));
+/* Sets the style of every cell of a rectangle of a Display, leaving their characters unchanged
+ * The rectangle is defined and clipped as for display_fill_rect
+ */
+void display_fill_style(Display *display, int row, int column, int height, int width, uint32_t style) {
+    if (!display_clip(display, &row, &column, &height, &width, NULL, NULL)) {
+        return;
+    }
+    for (int i = row; i < row + height; ++i) {
+        cells_fill(&display->_style_array[i*display->_columns + column], style, width);
+        display_mark_dirty(display, i, column, column + width);
+    }
 }
 
-/* Similar to display_set, but assumes const char *c is exactly CELLBYTES in length, padded with the appropriate amount
- *  of '\0' characters at the end if necessary, thus avoiding unnecessary checks
- * To be used by display_clear
+/* Interns a character, returning the glyph id cells use to hold it
+ * const char *c: '\0'-terminated UTF-8 bytes of a single character (possibly followed by combining characters), up to
+ *  GLYPH_MAX_BYTES long
+ * The same character always gets the same id, which stays valid for the whole run; ids should be interned once (e.g.
+ *  before the game loop) and drawn with display_set_id, so that drawing never has to look characters up
+ * Return: the glyph id of the character
  */
-void display_set_exact(Display *display, int row, int column, const char *c) {
-    memcpy(&display->_display_array[CELLBYTES*(row*display->_columns+column)], c, CELLBYTES*sizeof(char));
+uint32_t display_intern(const char *c) {
+    return glyph_intern(c, GLYPH_MAX_BYTES);
 }
@@ -1,3 +1,6 @@
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,33 +8,113 @@
 #include "../header/drawer.h"
 
 const char *CLEAR_SCREEN_ANSI = "\e[1;1H\e[2J";
+const char *RESET_STYLE_ANSI = "\e[0m";
+
+// incremented by the SIGWINCH handler whenever the terminal is resized; compared once per frame by drawer_draw_display
+//  with the generation each Drawer last followed, so every Drawer presenting to the terminal sees every resize
+static volatile sig_atomic_t resize_generation = 0;
+
+/* SIGWINCH handler
+ * Only counts the resize, so the terminal size is queried once per frame at most, and never while nothing changed
+ */
+static void handle_sigwinch(int sig) {
+    (void)sig;
+    resize_generation = resize_generation == SIG_ATOMIC_MAX ? 0 : resize_generation + 1;
+}
 
 /* Initializes a new Drawer
- * The timestamps and initial delay are initialized to 0
+ * The deadlines, frame period and frame time measurements are initialized to 0
  * Allocates space for the thread_id double pointer of the Drawer, which should be shared with the KeyListener
+ * Creates the Displays of the swap chain; buffer 0 starts as the back buffer, buffer 1 as ready and buffer 2 as front
+ * The Compositor starts without any layer (see drawer_add_layer)
+ * Installs a SIGWINCH handler, so that the Displays follow the size of the terminal (see drawer_draw_display)
  * Return: Pointer to the initialized Drawer
  */
 Drawer* init_drawer() {
     Drawer *new = malloc(sizeof(Drawer));
-    new->ld_sec = 0;
-    new->ld_msec = 0;
-    new->update_delay_s = 0;
-    new->update_delay_ms = 0;
-    new->display = init_display();
+    new->frame_period_ns = 0;
+    new->_deadline_ns = 0;
+    new->late_policy = FRAME_LATE_SKIP;
+    new->frame_time_ns = 0;
+    new->jitter_ns = 0;
+    new->max_jitter_ns = 0;
+    new->avg_jitter_ns = 0;
+    new->frames_late = 0;
+    new->_last_frame_ns = 0;
+    new->_frames_measured = 0;
+    for (int i = 0; i < DISPLAY_BUFFERS; ++i) {
+        new->_buffers[i] = init_display();
+        new->_buffer_frame[i] = 0;
+    }
+    new->_presented_frame = 0;
+    new->_back = 0;
+    atomic_init(&new->_ready, 1);
+    new->_front = 2;
+    new->display = new->_buffers[new->_back];
+    new->_rows = new->display->_rows;
+    new->_columns = new->display->_columns;
+    new->_args.drawer = new;
+    new->_args.queue = NULL;
     new->thread_id = NULL;
     new->exit_msg = NULL;
+    new->encoder = init_encoder();
+    new->compositor = init_compositor(new->_rows, new->_columns);
+    new->_presenter_running = 0;
+    atomic_init(&new->_presenter_stop, 0);
+    sem_init(&new->_present_sem, 0, 0);
+    atomic_init(&new->_frame_bytes, 0);
+    new->backend = init_terminal_backend();
+    new->_own_backend = 1;
+    new->fixed_size = 0;
+    new->paced = 1;
+    new->_on_frame = NULL;
+    new->_on_frame_ctx = NULL;
+    new->_on_clock = NULL;
+    new->_on_clock_ctx = NULL;
+    new->jobs = NULL;
+    new->_workers = JOBS_AUTO;
+    new->_resize_generation = resize_generation;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_sigwinch;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, NULL);
 
     return new;
 }
 
-/* Deletes a Drawer from memory, including its Display and the thread_id (if allocated)
+/* Deletes a Drawer from memory, including its Displays, layers, JobSystem, the thread_id (if allocated) and the terminal
+ *  backend it started with, unless another backend was set (see drawer_set_backend)
+ * The presenter thread is stopped first, so nothing else is written to the terminal afterwards
  */
 void delete_drawer(Drawer *drawer) {
-    delete_display(drawer->display);
+    if (drawer->_presenter_running) {
+        atomic_store(&drawer->_presenter_stop, 1);
+        sem_post(&drawer->_present_sem);
+        pthread_join(drawer->_presenter_id, NULL);
+    }
+    sem_destroy(&drawer->_present_sem);
+    for (int i = 0; i < DISPLAY_BUFFERS; ++i) {
+        delete_display(drawer->_buffers[i]);
+    }
+    delete_encoder(drawer->encoder);
+    delete_compositor(drawer->compositor);
+    if (drawer->jobs != NULL) {
+        delete_jobs(drawer->jobs);
+    }
     if (drawer->thread_id != NULL) {
         free(drawer->thread_id);
     }
-    clear_screen();
+    // don't leave the terminal set to the style of the last cell presented
+    if (drawer->backend->type == BACKEND_TERMINAL) {
+        write(STDOUT_FILENO, RESET_STYLE_ANSI, strlen(RESET_STYLE_ANSI));
+        clear_screen();
+    }
+    if (drawer->_own_backend) {
+        delete_backend(drawer->backend);
+    }
     if (drawer->exit_msg != NULL) {
         printf("%s\n", drawer->exit_msg);
         free(drawer->exit_msg);
@@ -39,57 +122,221 @@ void delete_drawer(Drawer *drawer) {
     free(drawer);
 }
 
+/* Presents the ready buffer, if it holds a frame which wasn't presented yet
+ * Swaps the ready buffer with the front buffer, encodes the front buffer and hands it to the backend of the Drawer
+ * Only the cells which changed since the last presented frame are encoded (see encoder_encode)
+ * The dirty ranges of a composed frame only cover the changes since the frame composed before it, so if that one
+ *  wasn't presented, every cell is compared instead (see encoder_rescan)
+ */
+static void drawer_present_ready(Drawer *drawer) {
+    if (!(atomic_load(&drawer->_ready) & FRAME_FRESH)) {
+        return;
+    }
+    int ready = atomic_exchange(&drawer->_ready, drawer->_front);
+    drawer->_front = ready & ~FRAME_FRESH;
+
+    unsigned long frame = drawer->_buffer_frame[drawer->_front];
+    if (frame != 0 && frame != drawer->_presented_frame + 1) {
+        encoder_rescan(drawer->encoder);
+    }
+    drawer->_presented_frame = frame;
+    size_t len = encoder_encode(drawer->encoder, drawer->_buffers[drawer->_front]);
+    backend_present(drawer->backend, drawer->_buffers[drawer->_front], drawer->encoder);
+    atomic_store_explicit(&drawer->_frame_bytes, len, memory_order_relaxed);
+}
+
+/* Function run by the presenter thread
+ * Sleeps until a frame is published, then presents it (see drawer_present_ready); if several frames were published in
+ *  the meantime, only the latest one is presented
+ */
+static void* drawer_present(void *args) {
+    Drawer *drawer = args;
+    while (1) {
+        sem_wait(&drawer->_present_sem);
+        if (atomic_load(&drawer->_presenter_stop)) {
+            break;
+        }
+        drawer_present_ready(drawer);
+    }
+
+    return NULL;
+}
+
+/* Waits until the next frame is due, then schedules the one after it
+ * Sleeps until an absolute deadline on the monotonic clock, so time spent by the game loop on the frame is accounted
+ *  for and errors don't accumulate from frame to frame
+ * If the frame missed its deadline by a whole frame period or more, the late policy decides the next deadline:
+ *  FRAME_LATE_SKIP moves it to the first one on the schedule which is still in the future, while FRAME_LATE_CATCHUP keeps
+ *  it (unless more than MAX_CATCHUP_FRAMES were missed), so the following frames are drawn without waiting
+ * If the Drawer isn't paced (see drawer->paced), the frame is due right away
+ * Also updates the frame time and jitter measurements of the Drawer
+ */
+static void drawer_pace(Drawer *drawer) {
+    long long now = get_monotonic_ns();
+    if (drawer->_deadline_ns == 0 || !drawer->paced) {
+        drawer->_deadline_ns = now;
+    }
+    else if (now < drawer->_deadline_ns) {
+        sleep_until_ns(drawer->_deadline_ns);
+        now = get_monotonic_ns();
+    }
+
+    long long period = drawer->frame_period_ns;
+    long long next = drawer->_deadline_ns + period;
+    if (period > 0 && now >= next) {
+        ++drawer->frames_late;
+        long long missed = (now - drawer->_deadline_ns) / period;
+        if (drawer->late_policy == FRAME_LATE_SKIP || missed > MAX_CATCHUP_FRAMES) {
+            next = drawer->_deadline_ns + (missed + 1) * period;
+        }
+    }
+    drawer->_deadline_ns = next;
+
+    if (drawer->_last_frame_ns != 0) {
+        drawer->frame_time_ns = now - drawer->_last_frame_ns;
+        drawer->jitter_ns = llabs(drawer->frame_time_ns - period);
+        if (drawer->jitter_ns > drawer->max_jitter_ns) {
+            drawer->max_jitter_ns = drawer->jitter_ns;
+        }
+        ++drawer->_frames_measured;
+        drawer->avg_jitter_ns += (drawer->jitter_ns - drawer->avg_jitter_ns) / drawer->_frames_measured;
+    }
+    drawer->_last_frame_ns = now;
+}
+
 /* Draws the display on the screen
  * Assumes setFPS has been called
- * Waits the preset amount of time so the framerate can be equal to the preset
+ * Waits until the next frame is due, so the framerate can be equal to the preset (see drawer_pace)
+ * The back buffer is then published to the presenter thread, which presents it to the backend (by default, writes it to
+ *  the terminal), and drawer->display is replaced by a new back buffer; this doesn't wait for the terminal, so the game
+ *  loop can carry on with the next frame while the previous one is being written
+ * Backends which must get every frame (see Backend) are presented to right away, on the calling thread, instead
+ * The new back buffer holds an older frame, so the game loop should redraw the whole Display (starting with
+ *  display_clear) on every frame
+ * If layers were added (see drawer_add_layer), they are composed into the back buffer before it is published instead,
+ *  and drawer->display shouldn't be drawn onto
+ * If the terminal was resized since the last frame, the new size is queried and an EVENT_RESIZE event (with the value
+ *  RESIZE_EVENT) is placed in the Queue;
+ *  each buffer is resized when it next becomes the back buffer, so drawer->display always has the current size
+ * Finally, the function set with drawer_on_frame is called, if any
  */
 void drawer_draw_display(Drawer *drawer) {
-    time_t sec;
-    long msec;
-    get_timestamp(&sec, &msec);
-
-    while (sec - drawer->ld_sec <= drawer->update_delay_s && msec - drawer->ld_msec <= drawer->update_delay_ms) {
-        usleep(10000);
-        get_timestamp(&sec, &msec);
-    }
-
-    ulong total_to_write = drawer->display->_rows * drawer->display->_columns * CELLBYTES * sizeof(char);
-    ssize_t written = 0;
-    ssize_t count;
-    do {
-        count = write(STDOUT_FILENO, &drawer->display->_display_array[written], total_to_write - written);
-        if (count != -1) {
-            written += count;
+    drawer_pace(drawer);
+
+    if (drawer->compositor->layer_count > 0) {
+        compositor_compose(drawer->compositor, drawer->display, &drawer->_buffer_frame[drawer->_back]);
+    }
+    int ready = atomic_exchange(&drawer->_ready, drawer->_back | FRAME_FRESH);
+    drawer->_back = ready & ~FRAME_FRESH;
+    drawer->display = drawer->_buffers[drawer->_back];
+    if (drawer->backend->every_frame) {
+        drawer_present_ready(drawer);
+    }
+    else {
+        sem_post(&drawer->_present_sem);
+    }
+
+    sig_atomic_t generation = resize_generation;
+    if (generation != drawer->_resize_generation && !drawer->fixed_size &&
+        drawer->backend->type == BACKEND_TERMINAL) {
+        drawer->_resize_generation = generation;
+        int rows, columns;
+        if (terminal_get_size(&rows, &columns) == 0) {
+            drawer_resize(drawer, rows, columns);
+            if (drawer->_args.queue != NULL) {
+                Event event = {get_monotonic_ns(), RESIZE_EVENT, EVENT_RESIZE, 0};
+                queue_put_local(drawer->_args.queue, &event);
+            }
         }
-    } while (written != total_to_write);
-    fflush(stdout);
+    }
+    display_resize(drawer->display, drawer->_rows, drawer->_columns);
 
-    get_timestamp(&drawer->ld_sec, &drawer->ld_msec);
+    if (drawer->_on_frame != NULL) {
+        drawer->_on_frame(drawer->_on_frame_ctx);
+    }
 }
 
 /* Determines the framerate the game will run at
  * This function must be called at least once before drawer_draw_display to initialize the FPS value
+ * Pacing restarts from the next frame drawn
  */
 int drawer_set_fps(Drawer *drawer, int val) {
      if (val <= 0) {
          return 1;
      }
 
-     drawer->update_delay_s = (int)(1.0 / val);
-     drawer->update_delay_ms = (long)((1.0 / val) * 1000);
+     drawer->frame_period_ns = 1000000000LL / val;
+     drawer->_deadline_ns = 0;
      return 0;
 }
 
+/* Determines what happens when a frame misses its deadline
+ * Accepts FRAME_LATE_SKIP or FRAME_LATE_CATCHUP (see drawer.h)
+ * Return: 0 if successful, else 1
+ */
+int drawer_set_late_policy(Drawer *drawer, int policy) {
+    if (policy != FRAME_LATE_SKIP && policy != FRAME_LATE_CATCHUP) {
+        return 1;
+    }
+
+    drawer->late_policy = policy;
+    return 0;
+}
+
+/* Determines the number of worker threads of the JobSystem created along with the drawer thread (see jobs.h), which
+ *  are started once the first job is submitted
+ * Accepts JOBS_AUTO (default), for one worker per core besides the drawer thread, or any number of workers; with 0,
+ *  jobs are run by the drawer thread itself
+ * Must be called before drawer_start_thread
+ * Return: 0 if successful, else 1
+ */
+int drawer_set_workers(Drawer *drawer, int workers) {
+    if (workers < JOBS_AUTO || drawer->jobs != NULL) {
+        return 1;
+    }
+
+    drawer->_workers = workers;
+    return 0;
+}
+
+/* Function run by the drawer thread
+ * Makes the drawer thread the owner of the JobSystem (see jobs_set_owner), runs the game loop function, then finishes
+ *  the Queue (see queue_finish) however the game loop function returned, so the KeyListener stops waiting for input and
+ *  exits
+ */
+static void* drawer_run(void *args) {
+    Drawer *drawer = args_get_drawer(args);
+    jobs_set_owner(drawer->jobs);
+    void *ret = drawer->_gameloop(args);
+    if (drawer->_args.queue != NULL) {
+        queue_finish(drawer->_args.queue);
+    }
+    return ret;
+}
+
 /* Starts the drawer thread, which runs the game loop function passed as argument f
  * Additionally, accepts the Drawer and the shared Queue
+ * The presenter thread, which writes the frames published by the game loop to the terminal, is started as well, and the
+ *  Drawer's JobSystem (drawer->jobs) is created, whose worker threads start once the game loop submits its first job
+ * The arguments of the game loop function are kept in the Drawer, so they remain valid after this function returns
+ * Once the game loop function returns, the Queue is finished (see drawer_run)
  */
 void drawer_start_thread(Drawer *drawer, Queue *queue, void *(*f)(void *args)) {
-    GameloopFuncArgs args;
-    args.drawer = drawer;
-    args.queue = queue;
+    drawer->_args.drawer = drawer;
+    drawer->_args.queue = queue;
+
+    if (!drawer->_presenter_running) {
+        pthread_create(&drawer->_presenter_id, NULL, drawer_present, drawer);
+        drawer->_presenter_running = 1;
+    }
 
+    if (drawer->jobs == NULL) {
+        drawer->jobs = init_jobs(drawer->_workers);
+    }
+
+    drawer->_gameloop = f;
     drawer->thread_id = malloc(sizeof(pthread_t));
-    pthread_create(drawer->thread_id, NULL, f, &args);
+    pthread_create(drawer->thread_id, NULL, drawer_run, &drawer->_args);
 }
 
 /* Used to set the message to be displayed after the game quits
@@ -112,6 +359,92 @@ void drawer_clear_exit_msg(Drawer *drawer) {
     }
 }
 
+/* Gets the number of bytes written to the terminal for the last frame presented
+ * Can be compared with rows*columns*CELLBYTES to measure the saving of only encoding changed cells without padding
+ */
+size_t drawer_frame_bytes(Drawer *drawer) {
+    return atomic_load_explicit(&drawer->_frame_bytes, memory_order_relaxed);
+}
+
+/* Adds a layer on top of the existing layers of the Drawer
+ * Layers are Displays which keep their contents across frames, and whose cells start out transparent;
+ *  drawer_draw_display composes them into the back buffer, each one over the layers added before it (see
+ *  compositor_compose)
+ * Only what changed in a layer since the last frame is recomposed, so a layer drawn once (e.g. a background) costs
+ *  nothing afterwards; a layer redrawn on every frame should be cleared first with display_clear, which makes its cells
+ *  transparent again
+ * Once a layer is added, the game loop should only draw onto layers, not onto drawer->display; layers are resized along
+ *  with the terminal, keeping the part of their contents which still fits
+ * Return: Pointer to the layer, owned by the Drawer, or NULL if it already has MAX_LAYERS layers
+ */
+Display* drawer_add_layer(Drawer *drawer) {
+    return compositor_add_layer(drawer->compositor);
+}
+
+/* Sets where the Drawer presents its frames: a terminal (default), memory, file, null or custom backend (see backend.h)
+ * The Backend isn't deleted by the Drawer, so a memory backend can still be checked after the game ends; the terminal
+ *  backend the Drawer started with is deleted
+ * Only a terminal backend makes the Displays follow the size of the terminal; with any other backend, the size should be
+ *  set with drawer_set_size, since there may be no terminal at all
+ * Must be called before the drawer thread is started
+ */
+void drawer_set_backend(Drawer *drawer, Backend *backend) {
+    if (drawer->_own_backend) {
+        delete_backend(drawer->backend);
+    }
+    drawer->backend = backend;
+    drawer->_own_backend = 0;
+}
+
+/* Gives the Displays of the Drawer (and its layers) a fixed size, instead of the size of the terminal, which is then
+ *  ignored
+ * Used to run a game without a terminal (see drawer_set_backend), e.g. to replay a recorded session (see replay.h) or in
+ *  benchmarks; must be called before the drawer thread is started
+ */
+void drawer_set_size(Drawer *drawer, int rows, int columns) {
+    drawer->fixed_size = 1;
+    drawer->_rows = rows;
+    drawer->_columns = columns;
+    for (int i = 0; i < DISPLAY_BUFFERS; ++i) {
+        display_resize(drawer->_buffers[i], rows, columns);
+    }
+    compositor_resize(drawer->compositor, rows, columns);
+}
+
+/* Changes the size of the Displays of the Drawer (and its layers) while the drawer thread runs, e.g. when the terminal
+ *  is resized (see drawer_draw_display) or a recorded resize is replayed (see replay.h)
+ * Must only be called on the drawer thread; the back buffer and the layers are resized right away, while the other
+ *  buffers, which the presenter thread may be reading, are resized when they next become the back buffer
+ */
+void drawer_resize(Drawer *drawer, int rows, int columns) {
+    drawer->_rows = rows;
+    drawer->_columns = columns;
+    compositor_resize(drawer->compositor, rows, columns);
+    display_resize(drawer->display, rows, columns);
+}
+
+/* Sets a function called whenever a frame is published by drawer_draw_display, once the back buffer was replaced
+ * f is called on the drawer thread, with ctx, before the game loop starts its next frame; used to record or replay
+ *  input frame by frame (see replay.h)
+ * Passing NULL as f removes the function
+ */
+void drawer_on_frame(Drawer *drawer, void (*f)(void *ctx), void *ctx) {
+    drawer->_on_frame = f;
+    drawer->_on_frame_ctx = ctx;
+}
+
+/* Sets a function through which engine_run passes the time elapsed between frames, which decides how many simulation
+ *  steps each frame runs (see engine.h)
+ * f is called on the drawer thread, with ctx, once a frame is published (after the function set with drawer_on_frame),
+ *  and returns the time the game should advance by; used to record the time each frame advanced the game by, and to
+ *  advance it by the same time in a replay, however fast frames are drawn (see replay.h)
+ * Passing NULL as f removes the function
+ */
+void drawer_on_clock(Drawer *drawer, long long (*f)(long long elapsed_ns, void *ctx), void *ctx) {
+    drawer->_on_clock = f;
+    drawer->_on_clock_ctx = ctx;
+}
+
 // Utility functions
 // The below functions are to be called by the game loop function to get the Drawer and Queue
 // They can be replaced by casting (void *args) to (GameloopFuncArgs *) and getting the Drawer and Queue from it
@@ -0,0 +1,285 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../header/encoder.h"
+
+const char *ERASE_SCREEN_ANSI = "\e[2J";
+
+/* Initializes a new Encoder
+ * No previous frame exists, so the first encoded frame will contain every cell
+ * Return: Pointer to the initialized Encoder
+ */
+Encoder* init_encoder() {
+    Encoder *new = malloc(sizeof(Encoder));
+    new->_prev_array = NULL;
+    new->_prev_style = NULL;
+    new->_pen = STYLE_DEFAULT;
+    new->_prev_dirty_rows = NULL;
+    new->_prev_dirty_start = NULL;
+    new->_prev_dirty_end = NULL;
+    new->_prev_rows = 0;
+    new->_prev_columns = 0;
+    new->_rescan = 0;
+    new->_out = NULL;
+    new->_out_cap = 0;
+    new->_out_len = 0;
+    new->frame_bytes = 0;
+    new->total_bytes = 0;
+    new->frames = 0;
+
+    return new;
+}
+
+/* Deletes an Encoder, including its previous frame and output buffer
+ */
+void delete_encoder(Encoder *encoder) {
+    free(encoder->_prev_array);
+    free(encoder->_prev_style);
+    free(encoder->_prev_dirty_rows);
+    free(encoder->_prev_dirty_start);
+    free(encoder->_prev_dirty_end);
+    free(encoder->_out);
+    free(encoder);
+}
+
+/* Makes sure the output buffer of the Encoder can hold at least size bytes
+ */
+static void encoder_reserve(Encoder *encoder, size_t size) {
+    if (size <= encoder->_out_cap) {
+        return;
+    }
+    encoder->_out = realloc(encoder->_out, size);
+    encoder->_out_cap = size;
+}
+
+/* Writes the SGR escape sequence setting the terminal to the given style to out
+ * The sequence starts by resetting every attribute, so it doesn't depend on the style the terminal was set to before
+ * Colours 0-15 use the short 30-37/90-97 (40-47/100-107) forms, the rest of the palette uses 38;5 (48;5)
+ * Return: number of bytes written to out
+ */
+static size_t encode_sgr(char *out, uint32_t style) {
+    size_t len = 0;
+    out[len++] = '\e';
+    out[len++] = '[';
+    out[len++] = '0';
+    if (style & STYLE_BOLD) {
+        len += sprintf(&out[len], ";1");
+    }
+    if (style & STYLE_UNDERLINE) {
+        len += sprintf(&out[len], ";4");
+    }
+    if (style & STYLE_REVERSE) {
+        len += sprintf(&out[len], ";7");
+    }
+    if (style & STYLE_FG_SET) {
+        unsigned int color = STYLE_FG_COLOR(style);
+        if (color < 8) {
+            len += sprintf(&out[len], ";%u", 30 + color);
+        }
+        else if (color < 16) {
+            len += sprintf(&out[len], ";%u", 90 + color - 8);
+        }
+        else {
+            len += sprintf(&out[len], ";38;5;%u", color);
+        }
+    }
+    if (style & STYLE_BG_SET) {
+        unsigned int color = STYLE_BG_COLOR(style);
+        if (color < 8) {
+            len += sprintf(&out[len], ";%u", 40 + color);
+        }
+        else if (color < 16) {
+            len += sprintf(&out[len], ";%u", 100 + color - 8);
+        }
+        else {
+            len += sprintf(&out[len], ";48;5;%u", color);
+        }
+    }
+    out[len++] = 'm';
+    return len;
+}
+
+/* Checks whether cell k of a row changed since the previous frame, either in its glyph or in its style
+ */
+static inline int cell_changed(const uint32_t *curr, const uint32_t *prev, const uint32_t *curr_style,
+                               const uint32_t *prev_style, int k) {
+    return curr[k] != prev[k] || curr_style[k] != prev_style[k];
+}
+
+/* Encodes the columns [start, end) of a row into out, leaving out cells which didn't change since the previous frame
+ * A cell is changed if either its character or its style differs from the previous frame
+ * Each run of changed cells is preceded by a cursor-positioning escape sequence, and runs separated by at most MERGE_GAP
+ *  unchanged cells are merged into one, since rewriting a few cells is cheaper than positioning the cursor again
+ * If full is set, every cell is considered changed
+ * uint32_t *pen: the style the terminal is set to; an SGR sequence is only emitted before a cell whose style differs
+ *  from it, after which it is updated
+ * The previous frame is updated with the cells encoded
+ * Return: number of bytes placed in out
+ */
+static size_t encode_row(char *out, const uint32_t *curr, uint32_t *prev, const uint32_t *curr_style,
+                         uint32_t *prev_style, uint32_t *pen, int row, int start, int end, int full) {
+    size_t len = 0;
+    int j = start;
+    while (j < end) {
+        if (!full && !cell_changed(curr, prev, curr_style, prev_style, j)) {
+            ++j;
+            continue;
+        }
+        // extend the run while changed cells keep appearing within MERGE_GAP cells of its end
+        int run_start = j;
+        int run_end = j + 1;
+        for (int k = run_end; k < end && k - run_end <= MERGE_GAP; ++k) {
+            if (full || cell_changed(curr, prev, curr_style, prev_style, k)) {
+                run_end = k + 1;
+            }
+        }
+
+        len += sprintf(&out[len], "\e[%d;%dH", row + 1, run_start + 1);
+        for (int k = run_start; k < run_end; ++k) {
+            if (curr_style[k] != *pen) {
+                len += encode_sgr(&out[len], curr_style[k]);
+                *pen = curr_style[k];
+            }
+            len += glyph_encode(&out[len], curr[k]);
+        }
+        memcpy(&prev[run_start], &curr[run_start], (size_t)(run_end - run_start) * CELLBYTES);
+        memcpy(&prev_style[run_start], &curr_style[run_start], (size_t)(run_end - run_start) * sizeof(uint32_t));
+        j = run_end;
+    }
+    return len;
+}
+
+/* Encodes a frame from the given Display into the output buffer of the Encoder
+ * Only cells which differ from the previously encoded frame are encoded (see encode_row), and the style of the terminal
+ *  is only changed when consecutive encoded cells have different styles
+ * Since every cell outside a Display's dirty ranges is empty, a cell can only differ from the previous frame if it is
+ *  within the dirty ranges of either the Display or the previous frame; only those rows and columns are visited, so the
+ *  cost of encoding depends on how much was drawn rather than on the size of the Display
+ * If there is no previous frame, or its size differs from the Display, every cell is encoded; after encoder_rescan,
+ *  every cell is visited, but only those which changed are encoded
+ * The previous frame and its dirty ranges are updated to match the Display
+ * Return: number of bytes placed in the output buffer
+ */
+size_t encoder_encode(Encoder *encoder, const Display *display) {
+    int rows = display->_rows;
+    int columns = display->_columns;
+    size_t cells = (size_t)rows * columns;
+
+    int full = 0;
+    if (encoder->_prev_array == NULL || encoder->_prev_rows != rows || encoder->_prev_columns != columns) {
+        free(encoder->_prev_array);
+        free(encoder->_prev_style);
+        free(encoder->_prev_dirty_rows);
+        free(encoder->_prev_dirty_start);
+        free(encoder->_prev_dirty_end);
+        encoder->_prev_array = malloc(cells * CELLBYTES);
+        encoder->_prev_style = malloc(cells * sizeof(uint32_t));
+        encoder->_prev_dirty_rows = calloc(DIRTY_WORDS(rows), sizeof(uint64_t));
+        encoder->_prev_dirty_start = malloc(rows * sizeof(int));
+        encoder->_prev_dirty_end = malloc(rows * sizeof(int));
+        encoder->_prev_rows = rows;
+        encoder->_prev_columns = columns;
+        full = 1;
+    }
+    int rescan = encoder->_rescan;
+    encoder->_rescan = 0;
+
+    // worst case: every cell holds a glyph of GLYPH_MAX_BYTES and changes style, and every other changed cell starts a
+    //  new run, each needing a cursor-positioning sequence
+    encoder_reserve(encoder, SGR_SEQ_MAX + strlen(ERASE_SCREEN_ANSI) + cells * (GLYPH_MAX_BYTES + SGR_SEQ_MAX) +
+                             (size_t)rows * (columns / 2 + 1) * CURSOR_SEQ_MAX);
+
+    char *out = encoder->_out;
+    size_t len = 0;
+    if (full) {
+        // the style of the terminal is unknown, so start from the default one; the terminal may also hold anything
+        //  (e.g. after being resized), so erase it with the default background
+        len += encode_sgr(&out[len], STYLE_DEFAULT);
+        memcpy(&out[len], ERASE_SCREEN_ANSI, strlen(ERASE_SCREEN_ANSI));
+        len += strlen(ERASE_SCREEN_ANSI);
+        encoder->_pen = STYLE_DEFAULT;
+    }
+    for (int w = 0; w < DIRTY_WORDS(rows); ++w) {
+        uint64_t curr_word = display->_dirty_rows[w];
+        uint64_t word = full || rescan ? ~(uint64_t)0 : curr_word | encoder->_prev_dirty_rows[w];
+        while (word) {
+            int i = w * DIRTY_WORD_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            if (i >= rows) {
+                break;
+            }
+
+            int start = 0;
+            int end = columns;
+            if (!full && !rescan) {
+                start = display->_dirty_start[i];
+                end = display->_dirty_end[i];
+                if (!((curr_word >> (i % DIRTY_WORD_BITS)) & 1)) {
+                    start = columns;
+                    end = 0;
+                }
+                if ((encoder->_prev_dirty_rows[w] >> (i % DIRTY_WORD_BITS)) & 1) {
+                    if (encoder->_prev_dirty_start[i] < start) {
+                        start = encoder->_prev_dirty_start[i];
+                    }
+                    if (encoder->_prev_dirty_end[i] > end) {
+                        end = encoder->_prev_dirty_end[i];
+                    }
+                }
+            }
+            len += encode_row(&out[len], &display->_display_array[i * columns], &encoder->_prev_array[i * columns],
+                              &display->_style_array[i * columns], &encoder->_prev_style[i * columns],
+                              &encoder->_pen, i, start, end, full);
+
+            encoder->_prev_dirty_start[i] = display->_dirty_start[i];
+            encoder->_prev_dirty_end[i] = display->_dirty_end[i];
+        }
+        encoder->_prev_dirty_rows[w] = curr_word;
+    }
+
+    encoder->_out_len = len;
+    encoder->frame_bytes = len;
+    encoder->total_bytes += len;
+    ++encoder->frames;
+    return len;
+}
+
+/* Discards the previous frame of the Encoder, so that the next encoded frame contains every cell
+ * Should be used whenever the terminal contents may no longer match the previous frame (e.g. after clearing it)
+ */
+void encoder_invalidate(Encoder *encoder) {
+    free(encoder->_prev_array);
+    encoder->_prev_array = NULL;
+}
+
+/* Makes the next frame encoded by the Encoder compare every cell with the previous frame
+ * Unlike encoder_invalidate, the terminal is assumed to still match the previous frame, so only changed cells are
+ *  written; should be used when the dirty ranges of the Display may not cover every change (e.g. the frames of a
+ *  Compositor, whose dirty ranges only cover the changes since the frame composed just before)
+ */
+void encoder_rescan(Encoder *encoder) {
+    encoder->_rescan = 1;
+}
+
+/* Writes the last encoded frame to the given file descriptor
+ * The whole frame is submitted with a single write call; further calls are only made if the write was partial or was
+ *  interrupted (the terminal may be in non-blocking mode, since the KeyListener sets O_NONBLOCK on it)
+ * Return: number of bytes written, or -1 if writing failed
+ */
+ssize_t encoder_submit(Encoder *encoder, int fd) {
+    size_t written = 0;
+    ssize_t count;
+    while (written != encoder->_out_len) {
+        count = write(fd, &encoder->_out[written], encoder->_out_len - written);
+        if (count == -1) {
+            if (errno == EAGAIN || errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        written += count;
+    }
+    return (ssize_t)written;
+}
@@ -0,0 +1,59 @@
+#include "../header/engine.h"
+
+/* Runs the game loop of a game with a fixed timestep, until its update callback returns something other than 0 or the
+ *  Queue is finished (see queue_finish)
+ * Must be called by the game loop function, on the drawer thread; the game loop function can return right after
+ * On every frame, the time elapsed since the previous frame is added to an accumulator, and update is called once for
+ *  each whole step the accumulator holds, so the game advances at tick_rate steps per second however fast frames are
+ *  drawn; render is then called with the fraction of a step left, and the frame is published with drawer_draw_display,
+ *  which paces the frames to the FPS value of the Drawer
+ * If a frame took so long that more than max_steps steps are due (e.g. the process was suspended), only max_steps are
+ *  run and the rest of the whole steps are dropped (counted in dropped_steps), so the game slows down for that frame
+ *  instead of spending ever longer catching up
+ * If the Drawer isn't paced, every frame advances the game by exactly one step, as if frames were drawn at tick_rate
+ * The time each frame advances the game by goes through the function set with drawer_on_clock, if any: a Recorder
+ *  records it, and a Replay replaces it with the recorded one, so a replay runs the same steps in every frame as the
+ *  recorded session, paced or not (see replay.h)
+ */
+void engine_run(Drawer *drawer, Queue *queue, EngineCallbacks *callbacks) {
+    int tick_rate = callbacks->tick_rate > 0 ? callbacks->tick_rate : ENGINE_DEFAULT_TICK_RATE;
+    int max_steps = callbacks->max_steps > 0 ? callbacks->max_steps : ENGINE_DEFAULT_MAX_STEPS;
+    long long step_ns = 1000000000LL / tick_rate;
+    double dt = (double)step_ns / 1e9;
+
+    callbacks->steps = 0;
+    callbacks->frames = 0;
+    callbacks->dropped_steps = 0;
+
+    // the first frame runs a single step, so the game is never rendered before it was updated
+    long long accumulator = step_ns;
+    long long previous = get_monotonic_ns();
+    while (!queue->finished) {
+        int steps = 0;
+        while (accumulator >= step_ns) {
+            if (steps == max_steps) {
+                callbacks->dropped_steps += (unsigned long)(accumulator / step_ns);
+                accumulator %= step_ns;
+                break;
+            }
+            if (callbacks->update(dt, callbacks->ctx)) {
+                return;
+            }
+            accumulator -= step_ns;
+            ++steps;
+            ++callbacks->steps;
+        }
+
+        callbacks->render(drawer->display, (double)accumulator / (double)step_ns, callbacks->ctx);
+        drawer_draw_display(drawer);
+        ++callbacks->frames;
+
+        long long now = get_monotonic_ns();
+        long long elapsed = drawer->paced ? now - previous : step_ns;
+        if (drawer->_on_clock != NULL) {
+            elapsed = drawer->_on_clock(elapsed, drawer->_on_clock_ctx);
+        }
+        accumulator += elapsed;
+        previous = now;
+    }
+}
@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include "../header/entities.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ENTITIES_X86
+#endif
+
+/* Scalar version of entities_step
+ */
+static void entities_step_scalar(float *pos, const float *vel, int count, float dt, float size) {
+    for (int i = 0; i < count; ++i) {
+        float p = pos[i] + vel[i] * dt;
+        if (p >= size) {
+            p -= size;
+        }
+        if (p < 0) {
+            p += size;
+        }
+        // a position just below 0 may round to size once wrapped
+        if (p >= size) {
+            p = 0;
+        }
+        pos[i] = p;
+    }
+}
+
+/* Scalar version of entities_cells
+ */
+static void entities_cells_scalar(int *cells, const float *pos, int count) {
+    for (int i = 0; i < count; ++i) {
+        cells[i] = (int)pos[i];
+    }
+}
+
+#ifdef ENTITIES_X86
+#ifdef __SSE2__
+/* SSE2 version of entities_step, moving 4 entities at a time
+ * The wrap-around is done with comparison masks instead of branches, in the same order as the scalar version, so every
+ *  version computes the same positions
+ */
+static void entities_step_sse2(float *pos, const float *vel, int count, float dt, float size) {
+    __m128 d = _mm_set1_ps(dt);
+    __m128 s = _mm_set1_ps(size);
+    __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 p = _mm_add_ps(_mm_loadu_ps(&pos[i]), _mm_mul_ps(_mm_loadu_ps(&vel[i]), d));
+        p = _mm_sub_ps(p, _mm_and_ps(_mm_cmpge_ps(p, s), s));
+        p = _mm_add_ps(p, _mm_and_ps(_mm_cmplt_ps(p, zero), s));
+        p = _mm_andnot_ps(_mm_cmpge_ps(p, s), p);
+        _mm_storeu_ps(&pos[i], p);
+    }
+    entities_step_scalar(&pos[i], &vel[i], count - i, dt, size);
+}
+
+/* SSE2 version of entities_cells, converting 4 positions at a time
+ */
+static void entities_cells_sse2(int *cells, const float *pos, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)&cells[i], _mm_cvttps_epi32(_mm_loadu_ps(&pos[i])));
+    }
+    entities_cells_scalar(&cells[i], &pos[i], count - i);
+}
+#endif
+
+/* AVX2 version of entities_step, moving 8 entities at a time
+ */
+__attribute__((target("avx2")))
+static void entities_step_avx2(float *pos, const float *vel, int count, float dt, float size) {
+    __m256 d = _mm256_set1_ps(dt);
+    __m256 s = _mm256_set1_ps(size);
+    __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 p = _mm256_add_ps(_mm256_loadu_ps(&pos[i]), _mm256_mul_ps(_mm256_loadu_ps(&vel[i]), d));
+        p = _mm256_sub_ps(p, _mm256_and_ps(_mm256_cmp_ps(p, s, _CMP_GE_OQ), s));
+        p = _mm256_add_ps(p, _mm256_and_ps(_mm256_cmp_ps(p, zero, _CMP_LT_OQ), s));
+        p = _mm256_andnot_ps(_mm256_cmp_ps(p, s, _CMP_GE_OQ), p);
+        _mm256_storeu_ps(&pos[i], p);
+    }
+    entities_step_scalar(&pos[i], &vel[i], count - i, dt, size);
+}
+
+/* AVX2 version of entities_cells, converting 8 positions at a time
+ */
+__attribute__((target("avx2")))
+static void entities_cells_avx2(int *cells, const float *pos, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i *)&cells[i], _mm256_cvttps_epi32(_mm256_loadu_ps(&pos[i])));
+    }
+    entities_cells_scalar(&cells[i], &pos[i], count - i);
+}
+#endif
+
+/* Moves count positions by their velocity times dt, wrapping them around a world of the given size
+ * Each kernel has AVX2 and SSE2 versions, as well as a scalar fallback, chosen as for the cell kernels (see cells.h)
+ */
+static void entities_step(float *pos, const float *vel, int count, float dt, float size) {
+#ifdef ENTITIES_X86
+    if (__builtin_cpu_supports("avx2")) {
+        entities_step_avx2(pos, vel, count, dt, size);
+        return;
+    }
+#ifdef __SSE2__
+    entities_step_sse2(pos, vel, count, dt, size);
+    return;
+#endif
+#endif
+    entities_step_scalar(pos, vel, count, dt, size);
+}
+
+/* Converts count positions, which are never negative, to the cells they are in
+ */
+static void entities_cells(int *cells, const float *pos, int count) {
+#ifdef ENTITIES_X86
+    if (__builtin_cpu_supports("avx2")) {
+        entities_cells_avx2(cells, pos, count);
+        return;
+    }
+#ifdef __SSE2__
+    entities_cells_sse2(cells, pos, count);
+    return;
+#endif
+#endif
+    entities_cells_scalar(cells, pos, count);
+}
+
+/* Initializes an empty EntityStore, with room for ENTITIES_DEFAULT_CAPACITY entities
+ * Return: Pointer to the initialized EntityStore
+ */
+EntityStore* init_entities() {
+    EntityStore *new = malloc(sizeof(EntityStore));
+    new->count = 0;
+    new->capacity = ENTITIES_DEFAULT_CAPACITY;
+    new->pos_row = malloc(new->capacity * sizeof(float));
+    new->pos_col = malloc(new->capacity * sizeof(float));
+    new->vel_row = malloc(new->capacity * sizeof(float));
+    new->vel_col = malloc(new->capacity * sizeof(float));
+    new->glyph = malloc(new->capacity * sizeof(uint32_t));
+    new->_slot = malloc(new->capacity * sizeof(uint32_t));
+    new->_index = malloc(new->capacity * sizeof(uint32_t));
+    new->_generation = malloc(new->capacity * sizeof(uint32_t));
+    new->_slots = 0;
+    new->_free = 0;
+    return new;
+}
+
+/* Deletes an EntityStore, along with every entity it holds
+ */
+void delete_entities(EntityStore *entities) {
+    free(entities->pos_row);
+    free(entities->pos_col);
+    free(entities->vel_row);
+    free(entities->vel_col);
+    free(entities->glyph);
+    free(entities->_slot);
+    free(entities->_index);
+    free(entities->_generation);
+    free(entities);
+}
+
+/* Doubles the capacity of an EntityStore
+ * Every entity has a slot, and only removed entities leave free slots, so there are never more slots than entities the
+ *  columns have room for
+ */
+static void entities_grow(EntityStore *entities) {
+    entities->capacity *= 2;
+    size_t capacity = (size_t)entities->capacity;
+    entities->pos_row = realloc(entities->pos_row, capacity * sizeof(float));
+    entities->pos_col = realloc(entities->pos_col, capacity * sizeof(float));
+    entities->vel_row = realloc(entities->vel_row, capacity * sizeof(float));
+    entities->vel_col = realloc(entities->vel_col, capacity * sizeof(float));
+    entities->glyph = realloc(entities->glyph, capacity * sizeof(uint32_t));
+    entities->_slot = realloc(entities->_slot, capacity * sizeof(uint32_t));
+    entities->_index = realloc(entities->_index, capacity * sizeof(uint32_t));
+    entities->_generation = realloc(entities->_generation, capacity * sizeof(uint32_t));
+}
+
+/* Adds an entity to an EntityStore, at index count
+ * float row, column: position of the entity, in cells; should be inside the world (see entities_integrate)
+ * float vel_row, vel_col: velocity of the entity
+ * uint32_t glyph: glyph id the entity is drawn with
+ * Return: handle of the new entity
+ */
+EntityHandle entities_add(EntityStore *entities, float row, float column, float vel_row, float vel_col, uint32_t glyph) {
+    if (entities->count == entities->capacity) {
+        entities_grow(entities);
+    }
+
+    uint32_t slot;
+    if (entities->_free < entities->_slots) {
+        slot = entities->_free;
+        entities->_free = entities->_index[slot];
+    }
+    else {
+        slot = entities->_slots++;
+        entities->_free = entities->_slots;
+        entities->_generation[slot] = 1;
+    }
+
+    int index = entities->count++;
+    entities->pos_row[index] = row;
+    entities->pos_col[index] = column;
+    entities->vel_row[index] = vel_row;
+    entities->vel_col[index] = vel_col;
+    entities->glyph[index] = glyph;
+    entities->_slot[index] = slot;
+    entities->_index[slot] = (uint32_t)index;
+    return ((EntityHandle)entities->_generation[slot] << 32) | slot;
+}
+
+/* Checks whether a handle refers to an entity of an EntityStore
+ * Return: 1 if the entity wasn't removed, else 0
+ */
+int entities_alive(const EntityStore *entities, EntityHandle handle) {
+    uint32_t slot = (uint32_t)handle;
+    return slot < entities->_slots && entities->_generation[slot] == (uint32_t)(handle >> 32);
+}
+
+/* Gets the index of an entity, i.e. the position of its components in the columns of the EntityStore
+ * The index stays valid until an entity is removed
+ * Return: the index of the entity, or -1 if it was removed
+ */
+int entities_index(const EntityStore *entities, EntityHandle handle) {
+    if (!entities_alive(entities, handle)) {
+        return -1;
+    }
+    return (int)entities->_index[(uint32_t)handle];
+}
+
+/* Gets the handle of the entity at the given index, from 0 to count - 1
+ * Return: the handle of the entity
+ */
+EntityHandle entities_handle(const EntityStore *entities, int index) {
+    uint32_t slot = entities->_slot[index];
+    return ((EntityHandle)entities->_generation[slot] << 32) | slot;
+}
+
+/* Removes an entity from an EntityStore, moving the last entity into its index (swap-remove), so the columns stay
+ *  packed in O(1)
+ * The slot of the entity is reused by the next entity added, with a new generation, so its handle stays invalid
+ * Return: 0 if successful, or 1 if the entity was already removed
+ */
+int entities_remove(EntityStore *entities, EntityHandle handle) {
+    int index = entities_index(entities, handle);
+    if (index < 0) {
+        return 1;
+    }
+    uint32_t slot = (uint32_t)handle;
+
+    int last = --entities->count;
+    if (index != last) {
+        entities->pos_row[index] = entities->pos_row[last];
+        entities->pos_col[index] = entities->pos_col[last];
+        entities->vel_row[index] = entities->vel_row[last];
+        entities->vel_col[index] = entities->vel_col[last];
+        entities->glyph[index] = entities->glyph[last];
+        entities->_slot[index] = entities->_slot[last];
+        entities->_index[entities->_slot[index]] = (uint32_t)index;
+    }
+
+    // generation 0 is skipped, so no handle is ever ENTITY_NONE
+    if (++entities->_generation[slot] == 0) {
+        entities->_generation[slot] = 1;
+    }
+    entities->_index[slot] = entities->_free;
+    entities->_free = slot;
+    return 0;
+}
+
+/* Removes every entity of an EntityStore, invalidating all their handles
+ */
+void entities_clear(EntityStore *entities) {
+    while (entities->count > 0) {
+        entities_remove(entities, entities_handle(entities, entities->count - 1));
+    }
+}
+
+/* Moves every entity by its velocity times dt, wrapping it around the edges of a toroidal world of the given rows and
+ *  columns, usually the size of the Display
+ * Same as entities_integrate_range over every entity
+ */
+void entities_integrate(EntityStore *entities, float dt, int rows, int columns) {
+    entities_integrate_range(entities, 0, entities->count, dt, rows, columns);
+}
+
+/* Moves the entities from index begin (included) to end (excluded) by their velocity times dt, wrapping them around the
+ *  edges of a toroidal world of the given rows and columns
+ * Each column of positions is updated by a vectorized kernel (AVX2 when the CPU supports it, SSE2 otherwise), which
+ *  computes the same positions as the scalar fallback; an entity should move by less than the size of the world at once
+ * Ranges which don't overlap can be integrated in parallel, e.g. by jobs_parallel_for
+ */
+void entities_integrate_range(EntityStore *entities, int begin, int end, float dt, int rows, int columns) {
+    if (end <= begin) {
+        return;
+    }
+    entities_step(&entities->pos_row[begin], &entities->vel_row[begin], end - begin, dt, (float)rows);
+    entities_step(&entities->pos_col[begin], &entities->vel_col[begin], end - begin, dt, (float)columns);
+}
+
+/* Draws every entity onto a Display, at the cell its position is in, with its glyph
+ * Positions are converted to cells ENTITIES_RENDER_BATCH entities at a time by a vectorized kernel, then set in a single
+ *  pass (see display_set_cells); entities outside the Display, e.g. after it shrank, aren't drawn
+ */
+void entities_render(const EntityStore *entities, Display *display) {
+    int rows[ENTITIES_RENDER_BATCH];
+    int columns[ENTITIES_RENDER_BATCH];
+    for (int i = 0; i < entities->count; i += ENTITIES_RENDER_BATCH) {
+        int count = entities->count - i < ENTITIES_RENDER_BATCH ? entities->count - i : ENTITIES_RENDER_BATCH;
+        entities_cells(rows, &entities->pos_row[i], count);
+        entities_cells(columns, &entities->pos_col[i], count);
+        display_set_cells(display, rows, columns, &entities->glyph[i], count);
+    }
+}
@@ -0,0 +1,121 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "../header/glyph.h"
+
+// the glyph table; glyphs[id - GLYPH_FIRST] holds the glyph with the given id
+static Glyph glyphs[GLYPH_MAX];
+// hash table mapping glyphs to ids; each slot holds an id, or GLYPH_NONE if it is empty
+static atomic_uint_least32_t slots[GLYPH_SLOTS];
+// number of glyphs interned so far
+static uint32_t glyph_count = 0;
+// held while adding a glyph to the table
+static pthread_mutex_t glyph_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Hashes the bytes of a glyph (FNV-1a)
+ */
+static uint32_t glyph_hash(const char *bytes, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Looks a glyph up in the hash table, starting from the slot given by its hash
+ * Return: the id of the glyph, or GLYPH_NONE if it wasn't found; *slot is set to the first empty slot probed
+ */
+static uint32_t glyph_find(const char *bytes, size_t len, uint32_t *slot) {
+    uint32_t i = glyph_hash(bytes, len) % GLYPH_SLOTS;
+    while (1) {
+        uint32_t id = atomic_load_explicit(&slots[i], memory_order_acquire);
+        if (id == GLYPH_NONE) {
+            *slot = i;
+            return GLYPH_NONE;
+        }
+        const Glyph *glyph = &glyphs[id - GLYPH_FIRST];
+        if (glyph->len == len && !memcmp(glyph->bytes, bytes, len)) {
+            return id;
+        }
+        i = (i + 1) % GLYPH_SLOTS;
+    }
+}
+
+/* Interns a glyph, returning its id
+ * const char *c: the UTF-8 bytes of a single character, '\0'-terminated unless it is max_len bytes long
+ * size_t max_len: maximum number of bytes read from c; at most GLYPH_MAX_BYTES are used
+ * Single ASCII characters don't need to be stored, since their id is the character itself; other glyphs are looked up
+ *  in the glyph table without locking, and added to it if they aren't there yet
+ * If the glyph table is full, GLYPH_INVALID is returned
+ * Return: the id of the glyph; an empty string is interned as a whitespace
+ */
+uint32_t glyph_intern(const char *c, size_t max_len) {
+    if (max_len > GLYPH_MAX_BYTES) {
+        max_len = GLYPH_MAX_BYTES;
+    }
+    size_t len = 0;
+    while (len < max_len && c[len] != '\0') {
+        ++len;
+    }
+    if (len == 0) {
+        return ' ';
+    }
+    if (len == 1 && (unsigned char)c[0] < GLYPH_FIRST) {
+        return (unsigned char)c[0];
+    }
+
+    uint32_t slot;
+    uint32_t id = glyph_find(c, len, &slot);
+    if (id != GLYPH_NONE) {
+        return id;
+    }
+
+    pthread_mutex_lock(&glyph_mutex);
+    // another thread may have added the glyph since it was looked up
+    id = glyph_find(c, len, &slot);
+    if (id == GLYPH_NONE) {
+        if (glyph_count == GLYPH_MAX) {
+            id = GLYPH_INVALID;
+        }
+        else {
+            Glyph *glyph = &glyphs[glyph_count];
+            memcpy(glyph->bytes, c, len);
+            glyph->len = (unsigned char)len;
+            id = GLYPH_FIRST + glyph_count++;
+            // publish the id only once the glyph is in place, so lock-free lookups never see a partial glyph
+            atomic_store_explicit(&slots[slot], id, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&glyph_mutex);
+    return id;
+}
+
+/* Gets an interned glyph, given its id
+ * Return: Pointer to the Glyph, or NULL if the id is not one of an interned glyph (e.g. ASCII ids)
+ */
+const Glyph* glyph_get(uint32_t id) {
+    if (id < GLYPH_FIRST || id - GLYPH_FIRST >= GLYPH_MAX) {
+        return NULL;
+    }
+    return &glyphs[id - GLYPH_FIRST];
+}
+
+/* Writes the UTF-8 bytes of the glyph with the given id to out
+ * out must be able to hold GLYPH_MAX_BYTES bytes
+ * GLYPH_NONE and control characters are written as a whitespace, so that the terminal cursor still advances by one cell
+ * Return: number of bytes written to out
+ */
+size_t glyph_encode(char *out, uint32_t id) {
+    if (id < GLYPH_FIRST) {
+        out[0] = id >= ' ' && id != 0x7f ? (char)id : ' ';
+        return 1;
+    }
+    const Glyph *glyph = glyph_get(id);
+    if (glyph == NULL || glyph->len == 0) {
+        out[0] = ' ';
+        return 1;
+    }
+    memcpy(out, glyph->bytes, glyph->len);
+    return glyph->len;
+}
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include "../header/grid.h"
+
+/* Initializes an empty Grid covering a world of the given rows and columns, e.g. the size of the Display
+ * Return: Pointer to the initialized Grid
+ */
+Grid* init_grid(int rows, int columns) {
+    Grid *new = malloc(sizeof(Grid));
+    new->rows = rows;
+    new->columns = columns;
+    new->count = 0;
+    new->moved = 0;
+    new->_head = malloc((size_t)rows * columns * sizeof(int));
+    for (int i = 0; i < rows * columns; ++i) {
+        new->_head[i] = GRID_NONE;
+    }
+    new->_next = NULL;
+    new->_prev = NULL;
+    new->_cell = NULL;
+    new->_handle = NULL;
+    new->_seen = NULL;
+    new->_stamp = 0;
+    new->_slots = 0;
+    return new;
+}
+
+/* Deletes a Grid
+ */
+void delete_grid(Grid *grid) {
+    free(grid->_head);
+    free(grid->_next);
+    free(grid->_prev);
+    free(grid->_cell);
+    free(grid->_handle);
+    free(grid->_seen);
+    free(grid);
+}
+
+/* Removes every entity from the Grid and changes the size of its world
+ * The entities are added back, in their new cells, by the next call to grid_update; should be called whenever the
+ *  Display is resized (EVENT_RESIZE)
+ */
+void grid_resize(Grid *grid, int rows, int columns) {
+    grid->rows = rows;
+    grid->columns = columns;
+    grid->count = 0;
+    grid->_head = realloc(grid->_head, (size_t)rows * columns * sizeof(int));
+    for (int i = 0; i < rows * columns; ++i) {
+        grid->_head[i] = GRID_NONE;
+    }
+    for (int i = 0; i < grid->_slots; ++i) {
+        grid->_cell[i] = GRID_NONE;
+    }
+}
+
+/* Makes room in the Grid for the slots of the given number of entities
+ */
+static void grid_reserve(Grid *grid, int slots) {
+    if (slots <= grid->_slots) {
+        return;
+    }
+    int capacity = grid->_slots ? grid->_slots : ENTITIES_DEFAULT_CAPACITY;
+    while (capacity < slots) {
+        capacity *= 2;
+    }
+    grid->_next = realloc(grid->_next, capacity * sizeof(int));
+    grid->_prev = realloc(grid->_prev, capacity * sizeof(int));
+    grid->_cell = realloc(grid->_cell, capacity * sizeof(int));
+    grid->_handle = realloc(grid->_handle, capacity * sizeof(EntityHandle));
+    grid->_seen = realloc(grid->_seen, capacity * sizeof(unsigned int));
+    for (int i = grid->_slots; i < capacity; ++i) {
+        grid->_cell[i] = GRID_NONE;
+        grid->_seen[i] = 0;
+    }
+    grid->_slots = capacity;
+}
+
+/* Unlinks a slot from the list of its cell
+ */
+static void grid_unlink(Grid *grid, int slot) {
+    int next = grid->_next[slot];
+    int prev = grid->_prev[slot];
+    if (prev != GRID_NONE) {
+        grid->_next[prev] = next;
+    }
+    else {
+        grid->_head[grid->_cell[slot]] = next;
+    }
+    if (next != GRID_NONE) {
+        grid->_prev[next] = prev;
+    }
+    grid->_cell[slot] = GRID_NONE;
+    --grid->count;
+}
+
+/* Links a slot at the head of the list of the given cell
+ */
+static void grid_link(Grid *grid, int slot, int cell) {
+    int head = grid->_head[cell];
+    grid->_next[slot] = head;
+    grid->_prev[slot] = GRID_NONE;
+    if (head != GRID_NONE) {
+        grid->_prev[head] = slot;
+    }
+    grid->_head[cell] = slot;
+    grid->_cell[slot] = cell;
+    ++grid->count;
+}
+
+/* Brings the Grid up to date with the positions of the entities of an EntityStore
+ * Entities which are in the same cell as at the last update are left alone, those which changed cell are moved to the
+ *  list of their new cell (counted in moved), new entities are added and removed entities are removed; entities outside
+ *  the world of the Grid aren't in it
+ * The Grid should only be updated from a single EntityStore
+ */
+void grid_update(Grid *grid, const EntityStore *entities) {
+    grid_reserve(grid, (int)entities->_slots);
+    // 0 is the stamp of slots never seen
+    if (++grid->_stamp == 0) {
+        grid->_stamp = 1;
+    }
+    grid->moved = 0;
+
+    int seen = 0;
+    for (int i = 0; i < entities->count; ++i) {
+        int slot = (int)entities->_slot[i];
+        int row = (int)entities->pos_row[i];
+        int column = (int)entities->pos_col[i];
+        int cell = row >= 0 && row < grid->rows && column >= 0 && column < grid->columns ?
+                   row * grid->columns + column : GRID_NONE;
+        if (cell == grid->_cell[slot]) {
+            // the slot may have been reused by a new entity since the last update
+            grid->_handle[slot] = entities_handle(entities, i);
+        }
+        else {
+            if (grid->_cell[slot] != GRID_NONE) {
+                grid_unlink(grid, slot);
+            }
+            if (cell != GRID_NONE) {
+                grid_link(grid, slot, cell);
+                grid->_handle[slot] = entities_handle(entities, i);
+            }
+            ++grid->moved;
+        }
+        if (cell != GRID_NONE) {
+            grid->_seen[slot] = grid->_stamp;
+            ++seen;
+        }
+    }
+
+    // entities which weren't seen were removed from the EntityStore
+    if (seen != grid->count) {
+        for (int slot = 0; slot < grid->_slots; ++slot) {
+            if (grid->_cell[slot] != GRID_NONE && grid->_seen[slot] != grid->_stamp) {
+                grid_unlink(grid, slot);
+            }
+        }
+    }
+}
+
+/* Copies the handles of the entities of a cell to out, after the n handles already there, up to max handles in total
+ * Return: the number of handles in out
+ */
+static int grid_collect(const Grid *grid, int cell, EntityHandle *out, int n, int max) {
+    for (int slot = grid->_head[cell]; slot != GRID_NONE && n < max; slot = grid->_next[slot]) {
+        out[n++] = grid->_handle[slot];
+    }
+    return n;
+}
+
+/* Wraps a coordinate around a world of the given size
+ */
+static int grid_wrap(int value, int size) {
+    return (value % size + size) % size;
+}
+
+/* Gets the entities in the given cell; coordinates outside the world wrap around its edges
+ * EntityHandle *out: array receiving the handles of the entities found, up to max
+ * Return: the number of handles written to out
+ */
+int grid_query_point(const Grid *grid, int row, int column, EntityHandle *out, int max) {
+    if (grid->rows <= 0 || grid->columns <= 0) {
+        return 0;
+    }
+    int cell = grid_wrap(row, grid->rows) * grid->columns + grid_wrap(column, grid->columns);
+    return grid_collect(grid, cell, out, 0, max);
+}
+
+/* Gets the entities in the rectangle starting at the given row and column, spanning the given height and width
+ * The rectangle wraps around the edges of the world, as entities do, and is clipped to the size of the world
+ * EntityHandle *out: array receiving the handles of the entities found, up to max
+ * Return: the number of handles written to out
+ */
+int grid_query_rect(const Grid *grid, int row, int column, int height, int width, EntityHandle *out, int max) {
+    if (height > grid->rows) {
+        height = grid->rows;
+    }
+    if (width > grid->columns) {
+        width = grid->columns;
+    }
+    if (height <= 0 || width <= 0) {
+        return 0;
+    }
+    row = grid_wrap(row, grid->rows);
+    column = grid_wrap(column, grid->columns);
+    int n = 0;
+    for (int i = 0; i < height && n < max; ++i) {
+        int base = ((row + i) % grid->rows) * grid->columns;
+        for (int j = 0; j < width && n < max; ++j) {
+            n = grid_collect(grid, base + (column + j) % grid->columns, out, n, max);
+        }
+    }
+    return n;
+}
+
+/* Gets the entities whose cell is within the given radius of the given cell, measured between cells (so a radius of 0
+ *  is the cell itself); the circle wraps around the edges of the world, as entities do
+ * EntityHandle *out: array receiving the handles of the entities found, up to max
+ * Return: the number of handles written to out
+ */
+int grid_query_radius(const Grid *grid, int row, int column, int radius, EntityHandle *out, int max) {
+    if (radius < 0 || grid->rows <= 0 || grid->columns <= 0) {
+        return 0;
+    }
+    // rows and columns further than half the world away are reached by wrapping around the other way
+    int reach_rows = radius < grid->rows / 2 ? radius : grid->rows / 2;
+    int reach_columns = radius < grid->columns / 2 ? radius : grid->columns / 2;
+    int n = 0;
+    for (int i = -reach_rows; i <= reach_rows && n < max; ++i) {
+        // even sizes reach the opposite row from both sides
+        if (i == reach_rows && i != -reach_rows && 2 * i == grid->rows) {
+            break;
+        }
+        int base = grid_wrap(row + i, grid->rows) * grid->columns;
+        for (int j = -reach_columns; j <= reach_columns && n < max; ++j) {
+            if (j == reach_columns && j != -reach_columns && 2 * j == grid->columns) {
+                break;
+            }
+            if (i * i + j * j <= radius * radius) {
+                n = grid_collect(grid, base + grid_wrap(column + j, grid->columns), out, n, max);
+            }
+        }
+    }
+    return n;
+}
+
+/* Calls f on every pair of colliding entities, i.e. entities in the same cell, passing it the last argument as well
+ * Each pair is reported once; the cost is the number of entities plus the number of pairs
+ * Return: the number of pairs
+ */
+size_t grid_for_each_pair(const Grid *grid, void (*f)(EntityHandle a, EntityHandle b, void *ctx), void *ctx) {
+    size_t pairs = 0;
+    for (int slot = 0; slot < grid->_slots; ++slot) {
+        if (grid->_cell[slot] == GRID_NONE) {
+            continue;
+        }
+        for (int other = grid->_next[slot]; other != GRID_NONE; other = grid->_next[other]) {
+            f(grid->_handle[slot], grid->_handle[other], ctx);
+            ++pairs;
+        }
+    }
+    return pairs;
+}
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include "../header/input.h"
+
+/* Initializes an InputState in which every action is up, with the default hold times (see input_set_hold)
+ * Return: Pointer to the initialized InputState
+ */
+InputState* init_input() {
+    InputState *new = malloc(sizeof(InputState));
+    for (int word = 0; word < INPUT_WORDS; ++word) {
+        atomic_init(&new->down[word], 0);
+        atomic_init(&new->held[word], 0);
+    }
+    for (int action = 0; action < INPUT_ACTIONS; ++action) {
+        atomic_init(&new->press_ns[action], 0);
+        new->_release_ns[action] = 0;
+    }
+    new->_press_hold_ns = INPUT_PRESS_HOLD_NS;
+    new->_repeat_hold_ns = INPUT_REPEAT_HOLD_NS;
+    atomic_init(&new->quit, 0);
+    return new;
+}
+
+/* Deletes an InputState
+ */
+void delete_input(InputState *input) {
+    free(input);
+}
+
+/* Checks whether an action is down, i.e. its key was pressed recently or is being held down (see InputState)
+ * Can be called from any thread; takes a single relaxed load, so it can be called for every action on every frame
+ * Return: 1 if the action is down, else 0 (also for actions outside of 0 to INPUT_ACTIONS - 1)
+ */
+int input_is_down(const InputState *input, int action) {
+    if (action < 0 || action >= INPUT_ACTIONS) {
+        return 0;
+    }
+    uint64_t word = atomic_load_explicit(&input->down[action >> 6], memory_order_relaxed);
+    return (int)((word >> (action & 63)) & 1);
+}
+
+/* Checks whether the key of an action is being held down, i.e. the terminal started repeating it
+ * Unlike input_is_down, this is only true once the first repeat arrives, so a single press never counts as held
+ * Return: 1 if the action is held, else 0
+ */
+int input_is_held(const InputState *input, int action) {
+    if (action < 0 || action >= INPUT_ACTIONS) {
+        return 0;
+    }
+    uint64_t word = atomic_load_explicit(&input->held[action >> 6], memory_order_relaxed);
+    return (int)((word >> (action & 63)) & 1);
+}
+
+/* Gets the time at which an action was last pressed (not repeated)
+ * Return: monotonic time in nanoseconds (see get_monotonic_ns), or 0 if the action was never pressed
+ */
+long long input_press_ns(const InputState *input, int action) {
+    if (action < 0 || action >= INPUT_ACTIONS) {
+        return 0;
+    }
+    return atomic_load_explicit(&input->press_ns[action], memory_order_relaxed);
+}
+
+/* Checks whether the KeyListener exits, e.g. because CTRL+C was read
+ * The game loop must then return, so the KeyListener can finish exiting; games which read the Queue get EVENT_QUIT as
+ *  well, but a game loop which only queries the InputState (see input_is_down) must check this on every frame, since the
+ *  KeyListener can't deliver EVENT_QUIT while nothing reads the Queue and it is full
+ * Return: 1 if the game should quit, else 0
+ */
+int input_quit_requested(const InputState *input) {
+    return atomic_load_explicit(&input->quit, memory_order_relaxed);
+}
+
+/* Sets the time an action stays down after a press of its key and after a repeat, in nanoseconds
+ * The defaults (INPUT_PRESS_HOLD_NS and INPUT_REPEAT_HOLD_NS) suit common repeat delays and rates; should be called
+ *  before keylistener_handle_in
+ * The press hold time is also the longest the KeyListener waits for the first repeat of a key (see EVENT_KEY_REPEAT), so
+ *  it should be longer than the terminal's repeat delay; a second press of the same key within it counts as a repeat
+ */
+void input_set_hold(InputState *input, long long press_hold_ns, long long repeat_hold_ns) {
+    input->_press_hold_ns = press_hold_ns;
+    input->_repeat_hold_ns = repeat_hold_ns;
+}
+
+/* Updates the state of an action whose key was read at the given time
+ * Only called by the KeyListener, which decides whether the key is a repeat (see EVENT_KEY_REPEAT), so the InputState
+ *  and the events of the Queue agree on every key; a repeat of an action which is still down makes it held and keeps it
+ *  down for another repeat interval, while anything else is a new press, even if the action is still down (e.g. a quick
+ *  double tap)
+ * int repeat: 1 if the key is a repeat, else 0
+ */
+void input_key(InputState *input, int action, long long now, int repeat) {
+    if (action < 0 || action >= INPUT_ACTIONS) {
+        return;
+    }
+    uint64_t bit = (uint64_t)1 << (action & 63);
+    int word = action >> 6;
+    uint64_t down = atomic_load_explicit(&input->down[word], memory_order_relaxed);
+    if (repeat && (down & bit) && now < input->_release_ns[action]) {
+        input->_release_ns[action] = now + input->_repeat_hold_ns;
+        atomic_fetch_or_explicit(&input->held[word], bit, memory_order_relaxed);
+        return;
+    }
+    input->_release_ns[action] = now + input->_press_hold_ns;
+    atomic_store_explicit(&input->press_ns[action], now, memory_order_relaxed);
+    atomic_fetch_and_explicit(&input->held[word], ~bit, memory_order_relaxed);
+    atomic_fetch_or_explicit(&input->down[word], bit, memory_order_relaxed);
+}
+
+/* Releases the actions which weren't repeated in time
+ * Only called by the KeyListener, whenever it wakes up
+ * Return: the time at which the next action which is down is released, unless repeated before, or -1 if none is down
+ */
+long long input_release_due(InputState *input, long long now) {
+    long long next = -1;
+    for (int word = 0; word < INPUT_WORDS; ++word) {
+        uint64_t down = atomic_load_explicit(&input->down[word], memory_order_relaxed);
+        uint64_t released = 0;
+        while (down) {
+            int bit = __builtin_ctzll(down);
+            down &= down - 1;
+            long long release = input->_release_ns[word * 64 + bit];
+            if (release <= now) {
+                released |= (uint64_t)1 << bit;
+            }
+            else if (next < 0 || release < next) {
+                next = release;
+            }
+        }
+        if (released) {
+            atomic_fetch_and_explicit(&input->held[word], ~released, memory_order_relaxed);
+            atomic_fetch_and_explicit(&input->down[word], ~released, memory_order_relaxed);
+        }
+    }
+    return next;
+}
+
+/* Releases every action
+ */
+void input_reset(InputState *input) {
+    for (int word = 0; word < INPUT_WORDS; ++word) {
+        atomic_store_explicit(&input->held[word], 0, memory_order_relaxed);
+        atomic_store_explicit(&input->down[word], 0, memory_order_relaxed);
+    }
+}
+
+/* Requests the game loop to quit (see input_quit_requested)
+ * Only called by the KeyListener, before it places EVENT_QUIT in the Queue
+ */
+void input_quit(InputState *input) {
+    atomic_store_explicit(&input->quit, 1, memory_order_relaxed);
+}
@@ -0,0 +1,477 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../header/jobs.h"
+
+// JobSystem the current thread is a worker of, if any
+static _Thread_local JobSystem *jobs_worker_of = NULL;
+// index of the deque of the current thread, if it is a worker: i for worker i
+static _Thread_local int jobs_self = 0;
+// state of the random number generator picking the deques the current thread steals from
+static _Thread_local unsigned int jobs_victim_state = 0;
+
+/* Defines the arguments of a worker thread
+ * JobSystem *jobs: the JobSystem
+ * int index: index of the worker, from 1 to the number of workers
+ */
+typedef struct {
+    JobSystem *jobs;
+    int index;
+} WorkerArgs;
+
+/* Defines a chunk of the range of a jobs_parallel_for call, run as a single job
+ * Job job: the job running the chunk
+ * size_t begin, end: the chunk
+ * void (*f)(size_t begin, size_t end, void *ctx): the function of the jobs_parallel_for call
+ * void *ctx: passed to f
+ */
+typedef struct {
+    Job job;
+    size_t begin;
+    size_t end;
+    void (*f)(size_t begin, size_t end, void *ctx);
+    void *ctx;
+} JobChunk;
+
+/* Pushes a job at the bottom of a deque; only called by the owner of the deque
+ * Return: 0 if successful, or 1 if the deque is full
+ */
+static int deque_push(JobDeque *deque, Job *job) {
+    long bottom = atomic_load_explicit(&deque->_bottom, memory_order_relaxed);
+    long top = atomic_load_explicit(&deque->_top, memory_order_acquire);
+    if (bottom - top >= JOBS_DEQUE_SIZE) {
+        return 1;
+    }
+    atomic_store_explicit(&deque->_jobs[bottom & (JOBS_DEQUE_SIZE - 1)], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->_bottom, bottom + 1, memory_order_relaxed);
+    return 0;
+}
+
+/* Pops the newest job from the bottom of a deque; only called by the owner of the deque
+ * Return: the job, or NULL if the deque is empty or its last job was stolen first
+ */
+static Job* deque_pop(JobDeque *deque) {
+    long bottom = atomic_load_explicit(&deque->_bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->_bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->_top, memory_order_relaxed);
+    if (top > bottom) {
+        atomic_store_explicit(&deque->_bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    Job *job = atomic_load_explicit(&deque->_jobs[bottom & (JOBS_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        // last job: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->_top, &top, top + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed)) {
+            job = NULL;
+        }
+        atomic_store_explicit(&deque->_bottom, bottom + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+/* Steals the oldest job from the top of a deque; can be called by any thread
+ * Return: the job, or NULL if the deque is empty or another thread took the job first
+ */
+static Job* deque_steal(JobDeque *deque) {
+    long top = atomic_load_explicit(&deque->_top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->_bottom, memory_order_acquire);
+    if (top >= bottom) {
+        return NULL;
+    }
+    Job *job = atomic_load_explicit(&deque->_jobs[top & (JOBS_DEQUE_SIZE - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->_top, &top, top + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;
+    }
+    return job;
+}
+
+/* Wakes up a sleeping worker, if there is one
+ * Called after a job is queued; only takes the lock if a worker sleeps
+ */
+static void jobs_wake(JobSystem *jobs, int all) {
+    if (atomic_load(&jobs->_sleeping) > 0) {
+        pthread_mutex_lock(&jobs->_lock);
+        if (all) {
+            pthread_cond_broadcast(&jobs->_wake);
+        }
+        else {
+            pthread_cond_signal(&jobs->_wake);
+        }
+        pthread_mutex_unlock(&jobs->_lock);
+    }
+}
+
+/* Gets the deque of the current thread
+ * Return: the deque of the worker or owner thread calling this, or NULL for any other thread, whose jobs go through
+ *  the injection queue
+ */
+static JobDeque* jobs_deque(JobSystem *jobs) {
+    if (jobs_worker_of == jobs) {
+        return &jobs->_deques[jobs_self];
+    }
+    if (pthread_equal(pthread_self(), jobs->_owner)) {
+        return &jobs->_deques[0];
+    }
+    return NULL;
+}
+
+/* Adds a job at the end of the injection queue; can be called by any thread
+ */
+static void jobs_inject(JobSystem *jobs, Job *job) {
+    job->_next = NULL;
+    pthread_mutex_lock(&jobs->_inject_lock);
+    if (jobs->_inject_tail == NULL) {
+        jobs->_inject_head = job;
+    }
+    else {
+        jobs->_inject_tail->_next = job;
+    }
+    jobs->_inject_tail = job;
+    atomic_fetch_add(&jobs->_injected, 1);
+    pthread_mutex_unlock(&jobs->_inject_lock);
+}
+
+/* Takes the oldest job of the injection queue; can be called by any thread
+ * Return: the job, or NULL if the injection queue is empty
+ */
+static Job* jobs_take_injected(JobSystem *jobs) {
+    if (atomic_load_explicit(&jobs->_injected, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&jobs->_inject_lock);
+    Job *job = jobs->_inject_head;
+    if (job != NULL) {
+        jobs->_inject_head = job->_next;
+        if (jobs->_inject_head == NULL) {
+            jobs->_inject_tail = NULL;
+        }
+        atomic_fetch_sub(&jobs->_injected, 1);
+    }
+    pthread_mutex_unlock(&jobs->_inject_lock);
+    return job;
+}
+
+static void* jobs_worker(void *args);
+
+/* Starts the worker threads, unless they were started already
+ * Called whenever jobs are submitted; only takes the lock the first time
+ */
+static void jobs_start(JobSystem *jobs) {
+    if (jobs->workers == 0 || atomic_load_explicit(&jobs->_started, memory_order_acquire)) {
+        return;
+    }
+    pthread_mutex_lock(&jobs->_lock);
+    if (!atomic_load_explicit(&jobs->_started, memory_order_relaxed)) {
+        for (int i = 0; i < jobs->workers; ++i) {
+            WorkerArgs *args = malloc(sizeof(WorkerArgs));
+            args->jobs = jobs;
+            args->index = i + 1;
+            pthread_create(&jobs->_threads[i], NULL, jobs_worker, args);
+        }
+        atomic_store_explicit(&jobs->_started, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&jobs->_lock);
+}
+
+static void jobs_run(JobSystem *jobs, Job *job);
+
+/* Queues a job whose dependencies have all finished in the deque of the current thread, or in the injection queue if
+ *  it has none (see jobs_deque)
+ * If the deque is full, the job is run right away instead
+ */
+static void jobs_queue(JobSystem *jobs, Job *job) {
+    JobDeque *deque = jobs_deque(jobs);
+    if (deque == NULL) {
+        jobs_inject(jobs, job);
+    }
+    else if (deque_push(deque, job)) {
+        jobs_run(jobs, job);
+        return;
+    }
+    atomic_fetch_add(&jobs->_queued, 1);
+}
+
+/* Runs a job, then marks it as finished and queues the dependents it was the last dependency of
+ * The job isn't touched once it is marked as finished, since the thread waiting for it may then free it
+ */
+static void jobs_run(JobSystem *jobs, Job *job) {
+    job->f(job->ctx);
+
+    int expected = JOB_OPEN;
+    while (!atomic_compare_exchange_weak_explicit(&job->_state, &expected, JOB_LOCKED, memory_order_acquire,
+                                                  memory_order_relaxed)) {
+        expected = JOB_OPEN;
+    }
+    int count = job->_dependents_count;
+    Job *dependents[JOB_MAX_DEPENDENTS];
+    for (int i = 0; i < count; ++i) {
+        dependents[i] = job->_dependents[i];
+    }
+    atomic_store_explicit(&job->_state, JOB_FINISHED, memory_order_release);
+
+    int queued = 0;
+    for (int i = 0; i < count; ++i) {
+        if (atomic_fetch_sub_explicit(&dependents[i]->_waiting, 1, memory_order_acq_rel) == 1) {
+            jobs_queue(jobs, dependents[i]);
+            ++queued;
+        }
+    }
+    if (queued) {
+        jobs_wake(jobs, queued > 1);
+    }
+}
+
+/* Takes a job to run: the newest job of the deque of the current thread, or else the oldest job of the injection
+ *  queue, or else the oldest job of another deque, trying every other deque once, starting from a random one
+ * Return: the job, or NULL if none was found
+ */
+static Job* jobs_take(JobSystem *jobs) {
+    JobDeque *own = jobs_deque(jobs);
+    Job *job = own != NULL ? deque_pop(own) : NULL;
+    if (job == NULL) {
+        job = jobs_take_injected(jobs);
+    }
+    if (job == NULL) {
+        int deques = jobs->workers + 1;
+        jobs_victim_state = jobs_victim_state * 1103515245u + 12345u;
+        int start = (int)((jobs_victim_state >> 16) % (unsigned int)deques);
+        for (int i = 0; i < deques && job == NULL; ++i) {
+            JobDeque *victim = &jobs->_deques[(start + i) % deques];
+            if (victim != own) {
+                job = deque_steal(victim);
+            }
+        }
+    }
+    if (job != NULL) {
+        atomic_fetch_sub(&jobs->_queued, 1);
+    }
+    return job;
+}
+
+/* Function run by the worker threads
+ * Runs jobs for as long as it finds any; once it looked for one JOBS_SPIN times in a row without finding any, sleeps
+ *  until a job is queued
+ */
+static void* jobs_worker(void *args) {
+    JobSystem *jobs = ((WorkerArgs *)args)->jobs;
+    jobs_worker_of = jobs;
+    jobs_self = ((WorkerArgs *)args)->index;
+    jobs_victim_state = (unsigned int)jobs_self;
+    free(args);
+
+    int idle = 0;
+    while (!atomic_load_explicit(&jobs->_stop, memory_order_relaxed)) {
+        Job *job = jobs_take(jobs);
+        if (job != NULL) {
+            jobs_run(jobs, job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < JOBS_SPIN) {
+            sched_yield();
+            continue;
+        }
+        // _sleeping is raised before _queued is checked, and _queued before _sleeping when queuing a job, so either the
+        //  worker sees the job or the thread queuing it sees the worker and wakes it up
+        pthread_mutex_lock(&jobs->_lock);
+        atomic_fetch_add(&jobs->_sleeping, 1);
+        while (atomic_load(&jobs->_queued) == 0 && !atomic_load(&jobs->_stop)) {
+            pthread_cond_wait(&jobs->_wake, &jobs->_lock);
+        }
+        atomic_fetch_sub(&jobs->_sleeping, 1);
+        pthread_mutex_unlock(&jobs->_lock);
+        idle = 0;
+    }
+    return NULL;
+}
+
+/* Initializes a JobSystem, owned by the calling thread (see jobs_set_owner)
+ * Called by drawer_start_thread, so the game loop can use the JobSystem of its Drawer (drawer->jobs)
+ * The worker threads are only started once the first job is submitted (see jobs_submit and jobs_parallel_for)
+ * int workers: number of worker threads, or JOBS_AUTO for one per core besides the owner thread; with 0 workers,
+ *  every job is run by the thread waiting for it
+ * Return: Pointer to the initialized JobSystem
+ */
+JobSystem* init_jobs(int workers) {
+    if (workers < 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 1 ? (int)cores - 1 : 0;
+    }
+
+    JobSystem *new = malloc(sizeof(JobSystem));
+    new->workers = workers;
+    new->_deques = aligned_alloc(_Alignof(JobDeque), (size_t)(workers + 1) * sizeof(JobDeque));
+    for (int i = 0; i <= workers; ++i) {
+        atomic_init(&new->_deques[i]._top, 0);
+        atomic_init(&new->_deques[i]._bottom, 0);
+    }
+    new->_threads = malloc((size_t)(workers > 0 ? workers : 1) * sizeof(pthread_t));
+    new->_owner = pthread_self();
+    atomic_init(&new->_started, 0);
+    new->_inject_head = NULL;
+    new->_inject_tail = NULL;
+    atomic_init(&new->_injected, 0);
+    pthread_mutex_init(&new->_inject_lock, NULL);
+    atomic_init(&new->_queued, 0);
+    atomic_init(&new->_sleeping, 0);
+    atomic_init(&new->_stop, 0);
+    pthread_mutex_init(&new->_lock, NULL);
+    pthread_cond_init(&new->_wake, NULL);
+    return new;
+}
+
+/* Stops the worker threads and deletes a JobSystem
+ * Every job submitted must have finished; called by delete_drawer
+ */
+void delete_jobs(JobSystem *jobs) {
+    pthread_mutex_lock(&jobs->_lock);
+    atomic_store(&jobs->_stop, 1);
+    pthread_cond_broadcast(&jobs->_wake);
+    pthread_mutex_unlock(&jobs->_lock);
+    if (atomic_load(&jobs->_started)) {
+        for (int i = 0; i < jobs->workers; ++i) {
+            pthread_join(jobs->_threads[i], NULL);
+        }
+    }
+    pthread_mutex_destroy(&jobs->_inject_lock);
+    pthread_mutex_destroy(&jobs->_lock);
+    pthread_cond_destroy(&jobs->_wake);
+    free(jobs->_threads);
+    free(jobs->_deques);
+    free(jobs);
+}
+
+/* Makes the calling thread the owner of the JobSystem, which pushes the jobs it submits to its own deque (see
+ *  JobSystem); any other thread which isn't a worker submits its jobs through the injection queue
+ * Called by the drawer thread before it runs the game loop, since the JobSystem of a Drawer is created by
+ *  drawer_start_thread on another thread; must be called before any job is submitted
+ */
+void jobs_set_owner(JobSystem *jobs) {
+    jobs->_owner = pthread_self();
+}
+
+/* Initializes a Job in place, which runs the given function with the given argument once submitted
+ * Dependencies can then be added with job_depends_on, before the job is submitted
+ */
+void job_init(Job *job, void (*f)(void *ctx), void *ctx) {
+    job->f = f;
+    job->ctx = ctx;
+    atomic_init(&job->_waiting, 1);
+    atomic_init(&job->_state, JOB_OPEN);
+    job->_dependents_count = 0;
+    job->_next = NULL;
+}
+
+/* Makes a job wait for another one to finish before it runs
+ * Must be called before the job is submitted; the dependency may already be submitted, running or finished
+ * Return: 0 if successful, or 1 if the dependency already has JOB_MAX_DEPENDENTS dependents
+ */
+int job_depends_on(Job *job, Job *dependency) {
+    int expected = JOB_OPEN;
+    while (!atomic_compare_exchange_weak_explicit(&dependency->_state, &expected, JOB_LOCKED, memory_order_acquire,
+                                                  memory_order_relaxed)) {
+        if (expected == JOB_FINISHED) {
+            return 0;
+        }
+        expected = JOB_OPEN;
+    }
+    if (dependency->_dependents_count == JOB_MAX_DEPENDENTS) {
+        atomic_store_explicit(&dependency->_state, JOB_OPEN, memory_order_release);
+        return 1;
+    }
+    atomic_fetch_add_explicit(&job->_waiting, 1, memory_order_relaxed);
+    dependency->_dependents[dependency->_dependents_count++] = job;
+    atomic_store_explicit(&dependency->_state, JOB_OPEN, memory_order_release);
+    return 0;
+}
+
+/* Checks whether a job has finished
+ * Return: 1 if the job has finished, else 0
+ */
+int job_finished(Job *job) {
+    return atomic_load_explicit(&job->_state, memory_order_acquire) == JOB_FINISHED;
+}
+
+/* Submits a job, which is queued in the deque of the current thread (or the injection queue, see JobSystem) right away
+ *  if it has no unfinished dependency, or else once its last dependency finishes
+ * Can be called by any thread, including from within a job; starts the worker threads the first time
+ */
+void jobs_submit(JobSystem *jobs, Job *job) {
+    jobs_start(jobs);
+    if (atomic_fetch_sub_explicit(&job->_waiting, 1, memory_order_acq_rel) == 1) {
+        jobs_queue(jobs, job);
+        jobs_wake(jobs, 0);
+    }
+}
+
+/* Blocks until a job has finished, running queued jobs (its own, or stolen from the workers) in the meantime, so the
+ *  thread waiting is never idle while there is work left
+ */
+void jobs_wait(JobSystem *jobs, Job *job) {
+    while (!job_finished(job)) {
+        Job *other = jobs_take(jobs);
+        if (other != NULL) {
+            jobs_run(jobs, other);
+        }
+        else {
+            sched_yield();
+        }
+    }
+}
+
+/* Function run by the jobs of a jobs_parallel_for call
+ */
+static void jobs_run_chunk(void *ctx) {
+    JobChunk *chunk = ctx;
+    chunk->f(chunk->begin, chunk->end, chunk->ctx);
+}
+
+/* Calls f on consecutive chunks of the range from begin (included) to end (excluded) in parallel, and blocks until
+ *  every chunk is done; the calling thread runs chunks as well
+ * Chunks may run in any order and on any thread, so f must only write to the part of the data its chunk covers
+ * size_t grain: number of indices per chunk, or 0 to split the range into JOBS_CHUNKS_PER_THREAD chunks per thread;
+ *  it is raised if the range would be split into more than JOBS_MAX_CHUNKS chunks
+ */
+void jobs_parallel_for(JobSystem *jobs, size_t begin, size_t end, size_t grain,
+                       void (*f)(size_t begin, size_t end, void *ctx), void *ctx) {
+    if (end <= begin) {
+        return;
+    }
+    size_t count = end - begin;
+    if (grain == 0) {
+        grain = count / ((size_t)(jobs->workers + 1) * JOBS_CHUNKS_PER_THREAD);
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    if ((count + grain - 1) / grain > JOBS_MAX_CHUNKS) {
+        grain = (count + JOBS_MAX_CHUNKS - 1) / JOBS_MAX_CHUNKS;
+    }
+    size_t chunks = (count + grain - 1) / grain;
+    // a single chunk, or nobody to share it with
+    if (chunks == 1 || jobs->workers == 0) {
+        f(begin, end, ctx);
+        return;
+    }
+    jobs_start(jobs);
+
+    JobChunk chunk[JOBS_MAX_CHUNKS];
+    for (size_t i = 0; i < chunks; ++i) {
+        chunk[i].begin = begin + i * grain;
+        chunk[i].end = i + 1 == chunks ? end : chunk[i].begin + grain;
+        chunk[i].f = f;
+        chunk[i].ctx = ctx;
+        job_init(&chunk[i].job, jobs_run_chunk, &chunk[i]);
+        atomic_store_explicit(&chunk[i].job._waiting, 0, memory_order_relaxed);
+        jobs_queue(jobs, &chunk[i].job);
+    }
+    jobs_wake(jobs, 1);
+    for (size_t i = 0; i < chunks; ++i) {
+        jobs_wait(jobs, &chunk[i].job);
+    }
+}
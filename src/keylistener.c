@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <pthread.h>
 #include "../header/keylistener.h"
@@ -29,12 +31,32 @@ KeyListener* init_keylistener(Queue *queue, Drawer *drawer) {
 
     new->eQueue = queue;
     new->rec_keycodes = init_keymap();
+    new->parser = init_keyparser();
+    new->input = init_input();
+    new->last_value = 0;
+    new->last_key_ns = 0;
+    new->last_repeat = 0;
     new->drawer = drawer;
 
     return new;
 }
 
-/* Deletes a KeyListener, including its internal KeyMap and all the values contained within it
+/* Requests the game loop to quit through the InputState (see input_quit_requested), then places an EVENT_QUIT event
+ *  (with the exit value 0) in the Queue
+ * Unlike other events, it must not be dropped if the Queue is full, so placing it is retried until the drawer thread
+ *  makes room for it, unless the drawer thread has already finished; a game loop which doesn't read the Queue finishes
+ *  it once it sees the request in the InputState and returns (see drawer_run)
+ */
+static void keylistener_put_exit(KeyListener *key_listener) {
+    Queue *queue = key_listener->eQueue;
+    input_quit(key_listener->input);
+    Event event = {get_monotonic_ns(), 0, EVENT_QUIT, 0};
+    while (queue_put_event(queue, &event) != 0 && !queue->finished) {
+        usleep(1000);
+    }
+}
+
+/* Deletes a KeyListener, including its internal KeyMap and all the values contained within it, and its InputState
  * Does not delete Queue, since it is shared and must be deleted separately; places value 0 in Queue instead, so that
  *  the drawer thread knows to quit once it is read
  * Returns terminal to original state
@@ -42,8 +64,10 @@ KeyListener* init_keylistener(Queue *queue, Drawer *drawer) {
 void delete_keylistener(KeyListener *key_listener) {
     tcsetattr(key_listener->fd, TCSAFLUSH, &key_listener->oldterm);
     fcntl(key_listener->fd, F_SETFL, key_listener->oldflags);
+    keylistener_put_exit(key_listener);
     delete_keymap(key_listener->rec_keycodes);
-    queue_put(key_listener->eQueue, 0);
+    delete_keyparser(key_listener->parser);
+    delete_input(key_listener->input);
     free(key_listener);
 }
 
@@ -55,53 +79,113 @@ void keylistener_add_key(KeyListener *key_listener, const char key[KEYSIZE], int
     keymap_put(key_listener->rec_keycodes, key, val);
 }
 
+/* Keys handled by keylistener_handle_key, from a single read or flush of the KeyParser
+ * KeyListener *key_listener: the KeyListener handling the keys
+ * long long now: monotonic time (see get_monotonic_ns) at which the keys were read
+ * int exit: set once a key signalling exit is read; any keys following it are ignored
+ */
+typedef struct {
+    KeyListener *key_listener;
+    long long now;
+    int exit;
+} KeyBatch;
+
+/* Handles a single key split from the input by the KeyParser
+ * If the key is contained in the internal KeyMap, places the corresponding value in the Queue; if it is CTRL+C or the
+ *  key corresponding to value 0, marks the batch for exit instead
+ */
+static void keylistener_handle_key(const char key[KEYSIZE], uint16_t modifiers, void *ctx) {
+    KeyBatch *batch = ctx;
+    KeyListener *key_listener = batch->key_listener;
+    if (batch->exit) {
+        return;
+    }
+    if (key[0] == 3 && !(modifiers & MOD_ALT)) {
+        batch->exit = 1;
+        return;
+    }
+    int val = keymap_get(key_listener->rec_keycodes, key);
+    if (val == KEYMAP_NONE) {
+        return;
+    }
+    if (!val) {
+        batch->exit = 1;
+        return;
+    }
+    Event event = {batch->now, val, EVENT_KEY, modifiers};
+    // the terminal only sends the first repeat of a key held down once its repeat delay has passed, which the press hold
+    //  time of the InputState covers, and the following ones every repeat interval
+    long long window = key_listener->last_repeat ? KEY_REPEAT_NS : key_listener->input->_press_hold_ns;
+    if (val == key_listener->last_value && batch->now - key_listener->last_key_ns < window) {
+        event.type = EVENT_KEY_REPEAT;
+    }
+    input_key(key_listener->input, val, batch->now, event.type == EVENT_KEY_REPEAT);
+    queue_put_event(key_listener->eQueue, &event);
+    key_listener->last_value = val;
+    key_listener->last_key_ns = batch->now;
+    key_listener->last_repeat = event.type == EVENT_KEY_REPEAT;
+}
+
 /* Handles input
  * This must be run on the main thread and blocks execution
- * Repeatedly reads input and, once a key contained in the internal KeyMap is read, places corresponding value in Queue
+ * Sleeps in poll until input is available on stdin, the Queue is finished (see queue_finish), a lone ESC must be
+ *  resolved or an action must be released (see InputState), so keys are handled as soon as they arrive and no CPU time
+ *  is used while there is no input
+ * Besides placing values in the Queue, keeps the state of the actions up to date (see input_is_down)
+ * Input is read KEYLISTENER_BUFFER bytes at a time and split into keys by the KeyParser, so every key of a read is
+ *  handled, even if several arrive at once, and a key split across reads is handled once it is complete
+ * Once a key contained in the internal KeyMap is read, places corresponding value in Queue
  * If key corresponding to value 0 is read, the value is placed in the Queue, after which the KeyListener waits for
  * the drawer thread to read the value 0 and exit and then exits itself
+ * Keys the drawer thread doesn't keep up with don't pile up: which of the pending keys are delivered is decided by the
+ *  policies of their values (see queue_set_policy)
  */
 void keylistener_handle_in(KeyListener *key_listener) {
-    char c[KEYSIZE];
-    for (int i = 0; i < KEYSIZE; ++i) {
-        c[i] = 0;
-    }
+    char buffer[KEYLISTENER_BUFFER];
+    KeyBatch batch = {key_listener, 0, 0};
+    struct pollfd fds[2] = {
+        {key_listener->fd, POLLIN, 0},
+        {queue_finish_fd(key_listener->eQueue), POLLIN, 0},
+    };
     while (1) {
-        usleep(10000);
-        int ecode = (int)read(key_listener->fd, c, KEYSIZE);
+        // only wake up without input to resolve a lone ESC or release the actions which weren't repeated in time
+        long long now = get_monotonic_ns();
+        long long deadline = keyparser_deadline(key_listener->parser);
+        long long release = input_release_due(key_listener->input, now);
+        if (release >= 0 && (deadline < 0 || release < deadline)) {
+            deadline = release;
+        }
+        int timeout = -1;
+        if (deadline >= 0) {
+            long long remaining = deadline - now;
+            timeout = remaining > 0 ? (int)((remaining + 999999) / 1000000) : 0;
+        }
+        int ready = poll(fds, 2, timeout);
 
-        if (key_listener->eQueue->finished) {
+        if (key_listener->eQueue->finished || (ready > 0 && (fds[1].revents & POLLIN))) {
             keylistener_exit(key_listener);
             return;
         }
 
-        if (ecode != -1) {
-            //printf("0: [%d], 1: [%d], 2: [%d], 3: [%d], 4: [%d] %d\n", c[0], c[1], c[2], c[3], c[4], ecode);
-            if (c[0] == 3) {
+        batch.now = get_monotonic_ns();
+        if (ready > 0 && (fds[0].revents & (POLLIN | POLLHUP))) {
+            int ecode = (int)read(key_listener->fd, buffer, KEYLISTENER_BUFFER);
+            // stdin was closed, so no more keys can be read
+            if (ecode == 0) {
                 keylistener_exit(key_listener);
                 return;
             }
-            if (keymap_has(key_listener->rec_keycodes, c)) {
-                int val = keymap_get(key_listener->rec_keycodes, c);
-                if (!val) {
-                    keylistener_exit(key_listener);
-                    return;
-                }
-                queue_put(key_listener->eQueue, val);
-            }
-            for (int i = 0; i < KEYSIZE; ++i) {
-                c[i] = 0;
+            if (ecode == -1) {
+                continue;
             }
+            keyparser_feed(key_listener->parser, buffer, (size_t)ecode, batch.now, keylistener_handle_key, &batch);
         }
-        else if (key_listener->eQueue->lpt_sec) {
-            time_t sec;
-            long msec;
-            get_timestamp(&sec, &msec);
-            if (sec > key_listener->eQueue->lpt_sec || msec - key_listener->eQueue->lpt_ms > 50) {
-                queue_clear(key_listener->eQueue);
-                key_listener->eQueue->lpt_sec = 0;
-            }
-
+        else {
+            keyparser_flush(key_listener->parser, batch.now, keylistener_handle_key, &batch);
+        }
+        if (batch.exit) {
+            keylistener_exit(key_listener);
+            return;
         }
     }
 }
@@ -112,9 +196,9 @@ void keylistener_handle_in(KeyListener *key_listener) {
  */
 void keylistener_exit(KeyListener *key_listener) {
     Queue *queue = key_listener->eQueue;
-    queue_put(queue, 0);
+    keylistener_put_exit(key_listener);
     Drawer *drawer = key_listener->drawer;
-    delete_keylistener(key_listener);
+    // the game loop may query the InputState of the KeyListener until it returns
     if (drawer->thread_id != NULL) {
         pthread_join(*drawer->thread_id, NULL);
     }
@@ -122,6 +206,7 @@ void keylistener_exit(KeyListener *key_listener) {
         printf("Warning: Key listener received exit signal, but drawer thread hasn't started\n");
         free(drawer->thread_id);
     }
+    delete_keylistener(key_listener);
     delete_drawer(drawer);
     delete_queue(queue);
 }
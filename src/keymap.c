@@ -1,96 +1,129 @@
 #include "../header/keymap.h"
 
+/* Packs the bytes of a key into an integer, so longer keys can be hashed and compared in a single operation
+ * Return: the packed key; 0 only for keys made of NUL bytes
+ */
+static uint64_t keymap_pack(const char key[KEYSIZE]) {
+    uint64_t packed = 0;
+    memcpy(&packed, key, KEYSIZE);
+    return packed;
+}
+
+/* Gets the multiplier of the hash function with the given seed
+ * Return: an odd 64-bit multiplier
+ */
+static uint64_t keymap_multiplier(uint64_t seed) {
+    return (0x9e3779b97f4a7c15ULL ^ (seed * 0xbf58476d1ce4e5b9ULL)) | 1;
+}
+
 /* Initializes an empty KeyMap
- * DEFSIZE is used as the number of buckets, as defined in keymap.h
  * Return: Pointer to the initialized KeyMap
  */
 KeyMap* init_keymap() {
     KeyMap *new = malloc(sizeof(KeyMap));
-    new->size = DEFSIZE;
-    new->array = malloc(sizeof(KeyMapItem*)*DEFSIZE);
+    for (int i = 0; i < 256; ++i) {
+        new->single[i] = KEYMAP_NONE;
+    }
+    new->_items = NULL;
+    new->_count = 0;
+    new->_capacity = 0;
+    new->_bits = 1;
+    new->_multiplier = keymap_multiplier(0);
+    new->_table = calloc((size_t)1 << new->_bits, sizeof(KeyMapItem));
     return new;
 }
 
 /* Deletes a KeyMap, as well as all the items contained within it
  */
 void delete_keymap(KeyMap *keymap) {
-    KeyMapItem *curr, *tmp;
-    for (int i = 0; i < keymap->size; ++i) {
-        curr = keymap->array[i];
-        if (curr == NULL) {
-            continue;
+    free(keymap->_items);
+    free(keymap->_table);
+    free(keymap);
+}
+
+/* Rebuilds the table of longer keys from the items of the KeyMap
+ * Starting from the smallest power of two at least twice the number of items, hash functions are tried until one maps
+ *  every item to a different slot; if none of KEYMAP_SEEDS does, the table size is doubled
+ */
+static void keymap_build(KeyMap *keymap) {
+    int bits = 1;
+    while ((1 << bits) < 2 * keymap->_count) {
+        ++bits;
+    }
+    while (1) {
+        size_t size = (size_t)1 << bits;
+        KeyMapItem *table = calloc(size, sizeof(KeyMapItem));
+        for (uint64_t seed = 0; seed < KEYMAP_SEEDS; ++seed) {
+            uint64_t multiplier = keymap_multiplier(seed);
+            int i;
+            for (i = 0; i < keymap->_count; ++i) {
+                KeyMapItem *slot = &table[(keymap->_items[i].key * multiplier) >> (64 - bits)];
+                if (slot->key != 0) {
+                    break;
+                }
+                *slot = keymap->_items[i];
+            }
+            if (i == keymap->_count) {
+                free(keymap->_table);
+                keymap->_table = table;
+                keymap->_bits = bits;
+                keymap->_multiplier = multiplier;
+                return;
+            }
+            memset(table, 0, size * sizeof(KeyMapItem));
         }
-        do {
-            tmp = curr;
-            curr = curr->next;
-            free(tmp);
-        } while (curr != NULL);
+        free(table);
+        ++bits;
     }
-    free(keymap);
 }
 
-/* Adds a new key-int pair to the KeyMap
- * Note: INT_MAX should not be used as a value for any key (see keymap_get)
- * The new item is placed at the beginning of its bucket's chain, ensuring the operation is O(1) regardless of chain size
- * The item's hash is calculated as (key[0] % size), where size is the number of buckets, and is used as the index to the
- *  array of buckets
+/* Adds a new key-int pair to the KeyMap, replacing the value of the key if it is already in the KeyMap
+ * Note: KEYMAP_NONE (INT_MAX) should not be used as a value for any key (see keymap_get)
+ * Single-byte keys are stored directly in O(1); adding a longer key rebuilds the table of longer keys (see KeyMap), so
+ *  keys should be added before input is handled, not while it is
  */
 void keymap_put(KeyMap *keymap, const char key[KEYSIZE], int val) {
-    KeyMapItem *item = malloc(sizeof(KeyMapItem));
-    memcpy(item->key, key, KEYSIZE);
-    item->val = val;
+    if (key[1] == 0) {
+        keymap->single[(unsigned char)key[0]] = val;
+        return;
+    }
 
-    int index = key[0] % keymap->size;
-    item->next = keymap->array[index];
-    keymap->array[index] = item;
+    uint64_t packed = keymap_pack(key);
+    for (int i = 0; i < keymap->_count; ++i) {
+        if (keymap->_items[i].key == packed) {
+            keymap->_items[i].val = val;
+            keymap_build(keymap);
+            return;
+        }
+    }
+    if (keymap->_count == keymap->_capacity) {
+        keymap->_capacity = keymap->_capacity ? keymap->_capacity * 2 : 16;
+        keymap->_items = realloc(keymap->_items, keymap->_capacity * sizeof(KeyMapItem));
+    }
+    keymap->_items[keymap->_count].key = packed;
+    keymap->_items[keymap->_count].val = val;
+    ++keymap->_count;
+    keymap_build(keymap);
 }
 
 /* Checks for the existence of a key in the KeyMap
- * If the key is found, it is placed at the beginning of its chain; this is done since keymap_has will almost always be
- *  followed by keymap_get, to ensure the following get operation will be O(1) instead of having to redo a potentially
- *  large linear search through the chain
- *  Return: 1 if key exists in KeyMap, else 0
+ * Return: 1 if key exists in KeyMap, else 0
  */
-int keymap_has(KeyMap *keymap, const char key[KEYSIZE]) {
-    int index = key[0] % keymap->size;
-    KeyMapItem *curr = keymap->array[index], *prev = NULL;
-    if (curr == NULL) {
-        return 0;
-    }
-    do {
-        // compare entire key to current chain item
-        if (!memcmp(curr->key, key, KEYSIZE)) {
-            // if found, place at beginning of chain (if it isn't there already)
-            if (prev != NULL) {
-                prev->next = curr->next;
-                curr->next = keymap->array[index];
-                keymap->array[index] = curr;
-            }
-            return 1;
-        }
-        prev = curr;
-        curr = curr->next;
-    } while (curr != NULL);
-
-    return 0;
+int keymap_has(const KeyMap *keymap, const char key[KEYSIZE]) {
+    return keymap_get(keymap, key) != KEYMAP_NONE;
 }
 
 /* Gets an item from the KeyMap, given its key
- * This operation assumes the key exists in the KeyMap and therefore should always be preceded by keymap_has, unless the
- *  caller knows the key exists in the KeyMap
- * If this function is called on a key which doesn't exist in the KeyMap, it will either crash (if the corresponding
- *  bucket doesn't contain any items) or will return INT_MAX (if the existing chain was traversed, but no keys matched)
+ * Takes the same time for every key: a single-byte key indexes the direct table, and a longer key is hashed to the only
+ *  slot of the table of longer keys which can hold it
+ * Return: the value the key is mapped to, or KEYMAP_NONE if the key doesn't exist in the KeyMap, so keymap_has doesn't
+ *  need to be called first
  */
-int keymap_get(KeyMap *keymap, const char key[KEYSIZE]) {
-    int index = key[0] % keymap->size;
-    KeyMapItem *curr = keymap->array[index];
-    do {
-        if (!memcmp(curr->key, key, KEYSIZE)) {
-            return curr->val;
-        }
-        curr = curr->next;
-    } while (curr != NULL);
-
-    return INT_MAX;
-
-}
\ No newline at end of file
+int keymap_get(const KeyMap *keymap, const char key[KEYSIZE]) {
+    if (key[1] == 0) {
+        return keymap->single[(unsigned char)key[0]];
+    }
+    uint64_t packed = keymap_pack(key);
+    const KeyMapItem *slot = &keymap->_table[(packed * keymap->_multiplier) >> (64 - keymap->_bits)];
+    return slot->key == packed ? slot->val : KEYMAP_NONE;
+}
@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../header/keyparser.h"
+
+/* Initializes a KeyParser, with no key being parsed
+ * Return: Pointer to the initialized KeyParser
+ */
+KeyParser* init_keyparser() {
+    KeyParser *new = malloc(sizeof(KeyParser));
+    memset(new, 0, sizeof(KeyParser));
+    new->state = KEYPARSER_GROUND;
+    return new;
+}
+
+/* Deletes a KeyParser, discarding the key being parsed, if any
+ */
+void delete_keyparser(KeyParser *parser) {
+    free(parser);
+}
+
+/* Discards the key being parsed and returns to state KEYPARSER_GROUND
+ */
+static void keyparser_reset(KeyParser *parser) {
+    parser->state = KEYPARSER_GROUND;
+    parser->_length = 0;
+    parser->_overflow = 0;
+    parser->_utf8_remaining = 0;
+    parser->_modifiers = 0;
+}
+
+/* Appends a byte to the key being parsed, or marks it as too long if it doesn't fit
+ */
+static void keyparser_append(KeyParser *parser, unsigned char byte) {
+    if (parser->_length < KEYPARSER_MAX_SEQUENCE) {
+        parser->_sequence[parser->_length++] = (char)byte;
+    }
+    else {
+        parser->_overflow = 1;
+    }
+}
+
+/* Passes the key being parsed to the callback, unless it doesn't fit in KEYSIZE bytes, and starts parsing the next one
+ */
+static void keyparser_emit(KeyParser *parser, void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx),
+                           void *ctx) {
+    if (!parser->_overflow && parser->_length <= KEYSIZE) {
+        char key[KEYSIZE] = {0};
+        memcpy(key, parser->_sequence, parser->_length);
+        f(key, parser->_modifiers, ctx);
+    }
+    keyparser_reset(parser);
+}
+
+/* Gets the modifiers of a key consisting of a single byte
+ * Return: MOD_CTRL for control characters (except tab, newline and carriage return), MOD_SHIFT for upper-case letters,
+ *  else 0
+ */
+static uint16_t byte_modifiers(unsigned char byte) {
+    if (byte < 0x20 && byte != '\t' && byte != '\n' && byte != '\r') {
+        return MOD_CTRL;
+    }
+    if (byte >= 'A' && byte <= 'Z') {
+        return MOD_SHIFT;
+    }
+    return 0;
+}
+
+/* Removes the modifier parameter from the complete escape sequence being parsed, adding it to its modifiers
+ * The parameter is 1 + a combination of the MOD_ flags, and is either the second parameter of a CSI sequence
+ *  ("\e[1;5A" becomes "\e[A", "\e[15;2~" becomes "\e[15~") or the only parameter of an SS3 sequence ("\eO2P" becomes
+ *  "\eOP"); sequences with any other parameters are left as they are
+ */
+static void keyparser_normalize(KeyParser *parser) {
+    char *seq = parser->_sequence;
+    int last = parser->_length - 1;
+    char final = seq[last];
+    int separator = 0;
+    for (int i = 2; i < last; ++i) {
+        if (seq[i] == ';' && !separator) {
+            separator = i;
+        }
+        else if (seq[i] < '0' || seq[i] > '9') {
+            return;
+        }
+    }
+    int modifier_start = separator ? separator + 1 : (seq[1] == 'O' ? 2 : last);
+    if (modifier_start >= last) {
+        return;
+    }
+    int modifier = 0;
+    for (int i = modifier_start; i < last && modifier < 256; ++i) {
+        modifier = modifier * 10 + (seq[i] - '0');
+    }
+    if (modifier < 1) {
+        return;
+    }
+    parser->_modifiers |= (uint16_t)((modifier - 1) & (MOD_SHIFT | MOD_ALT | MOD_CTRL));
+
+    // the first parameter is kept, unless it is the default 1 of a sequence not ending in '~'
+    int length = separator ? separator : 2;
+    if (length == 3 && seq[2] == '1' && final != '~') {
+        length = 2;
+    }
+    seq[length] = final;
+    parser->_length = length + 1;
+}
+
+/* Handles a byte read between keys, or following an ESC which doesn't start an escape sequence (in which case the key
+ *  is reported with MOD_ALT)
+ */
+static void keyparser_ground(KeyParser *parser, unsigned char byte, long long now,
+                             void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx), void *ctx) {
+    if (parser->_length == 0) {
+        parser->_start_ns = now;
+    }
+    if (byte == 0x1b) {
+        keyparser_append(parser, byte);
+        parser->state = KEYPARSER_ESC;
+        return;
+    }
+    // lead byte of a multi-byte UTF-8 character; the number of continuation bytes is told by its high bits
+    if (byte >= 0xc2 && byte <= 0xf4) {
+        keyparser_append(parser, byte);
+        parser->_utf8_remaining = byte >= 0xf0 ? 3 : byte >= 0xe0 ? 2 : 1;
+        parser->state = KEYPARSER_UTF8;
+        return;
+    }
+    // stray continuation byte, or byte which never occurs in UTF-8
+    if (byte >= 0x80) {
+        keyparser_reset(parser);
+        return;
+    }
+    keyparser_append(parser, byte);
+    parser->_modifiers |= byte_modifiers(byte);
+    keyparser_emit(parser, f, ctx);
+}
+
+/* Feeds bytes read from the terminal to a KeyParser
+ * Every key completed by these bytes is passed to f, along with its modifiers and ctx, in the order they were read
+ * A key left incomplete at the end of the bytes is completed by the bytes of the next call, or reported or discarded by
+ *  keyparser_flush if they don't arrive in time
+ * If the deadline of the incomplete key has already passed when the next bytes are fed (e.g. they were read late), the
+ *  key is resolved as by keyparser_flush before they are parsed, so a lone ESC followed by a late key is still reported
+ *  as ESC and then the key, not as ALT+key
+ * now is the monotonic time (see get_monotonic_ns) at which the bytes were read
+ */
+void keyparser_feed(KeyParser *parser, const char *bytes, size_t count, long long now,
+                    void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx), void *ctx) {
+    keyparser_flush(parser, now, f, ctx);
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char byte = (unsigned char)bytes[i];
+        switch (parser->state) {
+            case KEYPARSER_ESC:
+                if (byte == '[') {
+                    keyparser_append(parser, byte);
+                    parser->state = KEYPARSER_CSI;
+                }
+                else if (byte == 'O') {
+                    keyparser_append(parser, byte);
+                    parser->state = KEYPARSER_SS3;
+                }
+                else if (byte == 0x1b) {
+                    // the first ESC was the ESC key itself
+                    keyparser_emit(parser, f, ctx);
+                    keyparser_ground(parser, byte, now, f, ctx);
+                }
+                else {
+                    // ALT+key: the ESC is dropped, so the key matches the key pressed without ALT
+                    keyparser_reset(parser);
+                    parser->_modifiers = MOD_ALT;
+                    keyparser_ground(parser, byte, now, f, ctx);
+                }
+                break;
+            case KEYPARSER_CSI:
+            case KEYPARSER_SS3:
+                // CSI sequences can have parameter (0x30 to 0x3f) and intermediate (0x20 to 0x2f) bytes, SS3 sequences
+                //  only a modifier parameter
+                if (byte >= (parser->state == KEYPARSER_CSI ? 0x20 : 0x30) && byte <= 0x3f) {
+                    keyparser_append(parser, byte);
+                }
+                else if (byte >= 0x40 && byte <= 0x7e) {
+                    keyparser_append(parser, byte);
+                    if (!parser->_overflow) {
+                        keyparser_normalize(parser);
+                    }
+                    keyparser_emit(parser, f, ctx);
+                }
+                else {
+                    // the sequence was interrupted, so it is discarded and the byte starts the next key
+                    keyparser_reset(parser);
+                    keyparser_ground(parser, byte, now, f, ctx);
+                }
+                break;
+            case KEYPARSER_UTF8:
+                if (byte >= 0x80 && byte <= 0xbf) {
+                    keyparser_append(parser, byte);
+                    if (--parser->_utf8_remaining == 0) {
+                        keyparser_emit(parser, f, ctx);
+                    }
+                }
+                else {
+                    keyparser_reset(parser);
+                    keyparser_ground(parser, byte, now, f, ctx);
+                }
+                break;
+            default:
+                keyparser_ground(parser, byte, now, f, ctx);
+                break;
+        }
+    }
+}
+
+/* Gets the time by which the key being parsed should be complete, to be used as a timeout when waiting for input
+ * Return: monotonic time after which keyparser_flush resolves the key being parsed, or -1 if no key is being parsed
+ */
+long long keyparser_deadline(KeyParser *parser) {
+    if (parser->state == KEYPARSER_GROUND) {
+        return -1;
+    }
+    return parser->_start_ns + ESC_TIMEOUT_NS;
+}
+
+/* Resolves the key being parsed if it is still incomplete once its deadline (see keyparser_deadline) has passed
+ * An ESC on its own is reported as the ESC key, and ESC followed by only '[' or 'O' as ALT+'[' or ALT+'O'; any other
+ *  incomplete key is discarded
+ * Does nothing if no key is being parsed, or the deadline hasn't passed yet
+ */
+void keyparser_flush(KeyParser *parser, long long now,
+                     void (*f)(const char key[KEYSIZE], uint16_t modifiers, void *ctx), void *ctx) {
+    if (parser->state == KEYPARSER_GROUND || now < keyparser_deadline(parser)) {
+        return;
+    }
+    if (parser->state == KEYPARSER_ESC) {
+        keyparser_emit(parser, f, ctx);
+    }
+    else if ((parser->state == KEYPARSER_CSI || parser->state == KEYPARSER_SS3) && parser->_length == 2) {
+        unsigned char byte = (unsigned char)parser->_sequence[1];
+        keyparser_reset(parser);
+        parser->_modifiers = MOD_ALT;
+        keyparser_ground(parser, byte, now, f, ctx);
+    }
+    else {
+        keyparser_reset(parser);
+    }
+}
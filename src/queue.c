@@ -1,118 +1,575 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <sched.h>
 #include <math.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "../header/queue.h"
 
-/* Initializes an empty Queue
- * The timestamp value of the last put operation is initialized to 0
+// policy of the values which weren't given one
+static const EventPolicy default_policy = {QUEUE_POLICY_KEEP, 0, 0};
+
+/* Initializes an empty Queue of QUEUE_DEFAULT_CAPACITY events, which drops events put into it while it is full
  * Return: Pointer to the initialized Queue
  */
 Queue* init_queue() {
-    Queue *new = malloc(sizeof(Queue));
-    new->head = NULL;
-    new->tail = NULL;
-    new->lpt_sec = 0;
-    new->lpt_ms = 0;
-    if (pthread_mutex_init(&new->mutex, NULL) != 0) {
-        printf("Could not initialize queue mutex");
-        return NULL;
+    return init_queue_capacity(QUEUE_DEFAULT_CAPACITY, QUEUE_OVERFLOW_DROP);
+}
+
+/* Initializes an empty Queue
+ * size_t capacity: maximum number of events the Queue can hold; rounded up to a power of two
+ * int overflow_policy: what happens when a value is put into a full Queue; QUEUE_OVERFLOW_DROP or QUEUE_OVERFLOW_BLOCK
+ * Return: Pointer to the initialized Queue
+ */
+Queue* init_queue_capacity(size_t capacity, int overflow_policy) {
+    Queue *new = aligned_alloc(QUEUE_CACHE_LINE, sizeof(Queue));
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    atomic_init(&new->_tail, 0);
+    new->_head_cache = 0;
+    atomic_init(&new->_head, 0);
+    new->_tail_cache = 0;
+    new->_local_count = 0;
+    new->_coalesced = 0;
+    new->_direct = 0;
+    new->_observer = NULL;
+    new->_observer_ctx = NULL;
+    atomic_init(&new->_discard, 0);
+    new->_items = malloc(size * sizeof(Event));
+    new->capacity = size;
+    new->_mask = size - 1;
+    new->overflow_policy = overflow_policy;
+    atomic_init(&new->dropped, 0);
+    for (int i = 0; i < QUEUE_POLICIES; ++i) {
+        new->_policies[i] = default_policy;
     }
+    new->_ttl = 0;
+    new->_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    atomic_init(&new->_waiting, 0);
     new->finished = 0;
+    new->_finish_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
     return new;
 }
 
-/* Deletes an existing Queue, as well as the items contained within it
+/* Deletes an existing Queue, as well as the values contained within it
  * NOT THREAD SAFE: only the calling thread should be using the queue if this function is called
- * The function makes an attempt at mutual exclusion while it deletes QueueItems, but the mutex must be unlocked before
- *  it is destroyed; if after being unlocked, another thread accesses the Queue and begins an operation on it, then the
- *  Queue is destroyed by this thread before that operation finishes, it could cause unexpected results
  */
 void delete_queue(Queue *queue) {
-    pthread_mutex_lock(&queue->mutex);
-    QueueItem *curr = queue->head, *tmp;
-    while (curr != NULL) {
-        tmp = curr;
-        curr = curr->next;
-        free(tmp);
-    }
-    pthread_mutex_unlock(&queue->mutex);
-    pthread_mutex_destroy(&queue->mutex);
+    close(queue->_event_fd);
+    close(queue->_finish_fd);
+    free(queue->_items);
     free(queue);
 }
 
+/* Gets the index of the next value to be read by the consumer, skipping the values discarded by queue_clear
+ * Only called by the consumer thread
+ */
+static size_t queue_consumer_head(Queue *queue) {
+    size_t head = atomic_load_explicit(&queue->_head, memory_order_relaxed);
+    size_t discard = atomic_load_explicit(&queue->_discard, memory_order_acquire);
+    if ((ptrdiff_t)(discard - head) > 0) {
+        head = discard;
+        atomic_store_explicit(&queue->_head, head, memory_order_release);
+    }
+    return head;
+}
+
+/* Gets the policy of the key events of a value
+ * Return: the policy given to the value with queue_set_policy, or the default policy (QUEUE_POLICY_KEEP, without a TTL)
+ */
+static const EventPolicy* queue_policy(const Queue *queue, int val) {
+    if (val >= 0 && val < QUEUE_POLICIES) {
+        return &queue->_policies[val];
+    }
+    return &default_policy;
+}
+
+/* Gets the time against which the TTLs of the events are checked
+ * Return: the current monotonic time, or 0 if no policy has a TTL (or the policies don't apply, see queue_put_direct),
+ *  in which case the time isn't read at all
+ */
+static long long queue_now(const Queue *queue) {
+    return queue->_ttl && !queue->_direct ? get_monotonic_ns() : 0;
+}
+
+/* Checks whether an event read by the consumer must be skipped: it was superseded by a newer event (EVENT_NONE), or it
+ *  is a key event older than the TTL of its value
+ * Return: 1 if the event must be skipped, else 0
+ */
+static int queue_skipped(const Queue *queue, const Event *event, long long now) {
+    if (event->type == EVENT_NONE) {
+        return 1;
+    }
+    if (now == 0 || (event->type != EVENT_KEY && event->type != EVENT_KEY_REPEAT)) {
+        return 0;
+    }
+    const EventPolicy *policy = queue_policy(queue, event->value);
+    return policy->policy != QUEUE_POLICY_NEVER_DROP && policy->ttl_ns && now - event->time_ns > policy->ttl_ns;
+}
+
+/* Marks the pending events superseded by newer ones as EVENT_NONE, according to the policies of their values
+ * Only called by the consumer thread, on the events between its head index and the tail index it last read, which the
+ *  producer doesn't write to; events are walked from the newest to the oldest, so that:
+ * - an event of a QUEUE_POLICY_LATEST value is superseded by any newer event of the same group
+ * - a repeat (EVENT_KEY_REPEAT) of a QUEUE_POLICY_KEEP value is superseded by a repeat of the same value immediately
+ *  following it, so a run of repeats collapses into its last one, while presses (EVENT_KEY) are all kept
+ * - events of QUEUE_POLICY_NEVER_DROP values and events which aren't key events are never superseded
+ */
+static void queue_coalesce(Queue *queue, size_t head, size_t tail) {
+    uint64_t groups = 0;
+    // type and value of the next key event, or EVENT_NONE if the next event isn't a key event
+    int next_type = EVENT_NONE;
+    int next_value = 0;
+    for (size_t i = tail; (ptrdiff_t)(i - head) > 0;) {
+        Event *event = &queue->_items[--i & queue->_mask];
+        if (event->type == EVENT_NONE) {
+            continue;
+        }
+        if (event->type != EVENT_KEY && event->type != EVENT_KEY_REPEAT) {
+            next_type = EVENT_NONE;
+            continue;
+        }
+        const EventPolicy *policy = queue_policy(queue, event->value);
+        int superseded = 0;
+        if (policy->policy == QUEUE_POLICY_LATEST) {
+            uint64_t group = (uint64_t)1 << (policy->group & (QUEUE_POLICY_GROUPS - 1));
+            superseded = (groups & group) != 0;
+            groups |= group;
+        }
+        else if (policy->policy == QUEUE_POLICY_KEEP) {
+            superseded = event->type == EVENT_KEY_REPEAT && next_type == EVENT_KEY_REPEAT && next_value == event->value;
+        }
+        // the event is the next one of the event before it even if superseded, so a whole run of repeats collapses
+        next_type = event->type;
+        next_value = event->value;
+        if (superseded) {
+            event->type = EVENT_NONE;
+        }
+    }
+}
+
+/* Gets the index of the next event to be delivered to the consumer, applying the policies to the pending events and
+ *  skipping the ones they discard
+ * Only called by the consumer thread; the tail index of the producer is only read if no event is known to be available
+ *  yet, and the policies are only applied again once it was
+ */
+static size_t queue_consumer_next(Queue *queue, long long now) {
+    size_t head = queue_consumer_head(queue);
+    size_t start = head;
+    while (1) {
+        if (queue->_coalesced != queue->_tail_cache && !queue->_direct) {
+            queue_coalesce(queue, head, queue->_tail_cache);
+            queue->_coalesced = queue->_tail_cache;
+        }
+        while ((ptrdiff_t)(queue->_tail_cache - head) > 0 &&
+               queue_skipped(queue, &queue->_items[head & queue->_mask], now)) {
+            ++head;
+        }
+        if ((ptrdiff_t)(queue->_tail_cache - head) > 0) {
+            break;
+        }
+        size_t tail = atomic_load_explicit(&queue->_tail, memory_order_acquire);
+        if (tail == queue->_tail_cache) {
+            break;
+        }
+        queue->_tail_cache = tail;
+    }
+    if (head != start) {
+        atomic_store_explicit(&queue->_head, head, memory_order_release);
+    }
+    return head;
+}
+
 /* Checks for emptiness of Queue
- * THREAD SAFE
+ * Must only be called by the consumer thread
+ * Events discarded by the policies of their values (see queue_set_policy) don't count
  * Return: 1 if Queue is empty, else 0
  */
 int queue_empty(Queue *queue) {
-    pthread_mutex_lock(&queue->mutex);
-    int empty = (queue->head == NULL);
-    pthread_mutex_unlock(&queue->mutex);
-    return empty;
+    if (queue->_local_count > 0) {
+        return 0;
+    }
+    size_t head = queue_consumer_next(queue, queue_now(queue));
+    return (ptrdiff_t)(queue->_tail_cache - head) <= 0;
+}
+
+/* Adds a new event to the end of the Queue
+ * Must only be called by the producer thread
+ * If the Queue is full, the event is dropped (QUEUE_OVERFLOW_DROP), or the function waits until the consumer makes room
+ *  for it (QUEUE_OVERFLOW_BLOCK, or a key event of a QUEUE_POLICY_NEVER_DROP value), unless the Queue is finished, in
+ *  which case it is dropped as well; dropped events are counted in queue->dropped
+ * If the consumer is waiting for an event (see queue_wait_until), its event file descriptor is signalled
+ * Return: 0 if the event was added, or 1 if it was dropped
+ */
+int queue_put_event(Queue *queue, const Event *event) {
+    size_t tail = atomic_load_explicit(&queue->_tail, memory_order_relaxed);
+    if (tail - queue->_head_cache == queue->capacity) {
+        int never_drop = (event->type == EVENT_KEY || event->type == EVENT_KEY_REPEAT) &&
+                         queue_policy(queue, event->value)->policy == QUEUE_POLICY_NEVER_DROP;
+        queue->_head_cache = atomic_load_explicit(&queue->_head, memory_order_acquire);
+        while (tail - queue->_head_cache == queue->capacity) {
+            if ((queue->overflow_policy == QUEUE_OVERFLOW_DROP && !never_drop) || queue->finished) {
+                atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+                return 1;
+            }
+            sched_yield();
+            queue->_head_cache = atomic_load_explicit(&queue->_head, memory_order_acquire);
+        }
+    }
+
+    queue->_items[tail & queue->_mask] = *event;
+    atomic_store_explicit(&queue->_tail, tail + 1, memory_order_release);
+    // pairs with the fence of queue_arm: either the consumer sees the event before waiting, or it is signalled here
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->_waiting, memory_order_relaxed)) {
+        uint64_t one = 1;
+        write(queue->_event_fd, &one, sizeof(one));
+    }
+    return 0;
 }
 
 /* Adds a new value to the end of the Queue
- * THREAD SAFE
- * If the Queue contained no items, the newly added item will be both head and tail
- */
-void queue_put(Queue *queue, int val) {
-    // create new QueueItem
-    QueueItem *new = malloc(sizeof(QueueItem));
-    new->val = val;
-    new->next = NULL;
-    pthread_mutex_lock(&queue->mutex);
-    // if queue is empty, add item as both head and tail
-    if (queue->head == NULL) {
-        queue->head = new;
-        queue->tail = new;
-    }
-    else {
-        // make previous last item (tail) point to the new item
-        queue->tail->next = new;
-        // make the new item the last item (tail)
-        queue->tail = new;
-    }
-    get_timestamp(&queue->lpt_sec, &queue->lpt_ms);
-    pthread_mutex_unlock(&queue->mutex);
-}
-
-/* Gets and removes the next item from the Queue
- * THREAD SAFE
+ * Same as queue_put_event, with an EVENT_KEY event (or EVENT_QUIT if the value is 0) holding the value, timestamped
+ *  with the current time
+ * Return: 0 if the value was added, or 1 if it was dropped
+ */
+int queue_put(Queue *queue, int val) {
+    Event event = {get_monotonic_ns(), val, val == 0 ? EVENT_QUIT : EVENT_KEY, 0};
+    return queue_put_event(queue, &event);
+}
+
+/* Adds a new event to the Queue from the consumer thread itself (e.g. EVENT_RESIZE, placed by the Drawer)
+ * Must only be called by the consumer thread; the event is kept apart from the ring buffer, which only the producer may
+ *  write to, and is read before the events of the ring buffer
+ * At most QUEUE_LOCAL_CAPACITY such events can be pending; further events are dropped
+ */
+void queue_put_local(Queue *queue, const Event *event) {
+    if (queue->_local_count == QUEUE_LOCAL_CAPACITY) {
+        atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    queue->_local[queue->_local_count++] = *event;
+}
+
+/* Adds a new event to the end of the Queue from the consumer thread itself, as it was delivered to a consumer before
+ *  (e.g. the events of a recording, placed by the Replay)
+ * Must only be called by the consumer thread, while no producer puts events into the Queue; unlike queue_put_event, it
+ *  never waits for room, since only the caller could make it, so the event is dropped (and counted in queue->dropped)
+ *  if the Queue is full
+ * The events were already filtered by the policies of their values when they were first delivered, so from the first
+ *  call on, the policies no longer apply to the Queue (see queue_set_policy): every event put is delivered as is
+ * Return: 0 if the event was added, or 1 if it was dropped
+ */
+int queue_put_direct(Queue *queue, const Event *event) {
+    queue->_direct = 1;
+    size_t head = queue_consumer_head(queue);
+    size_t tail = atomic_load_explicit(&queue->_tail, memory_order_relaxed);
+    if (tail - head == queue->capacity) {
+        atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        return 1;
+    }
+    queue->_items[tail & queue->_mask] = *event;
+    atomic_store_explicit(&queue->_tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+/* Removes the oldest event placed with queue_put_local, copying it into event
+ */
+static void queue_take_local(Queue *queue, Event *event) {
+    *event = queue->_local[0];
+    --queue->_local_count;
+    for (int i = 0; i < queue->_local_count; ++i) {
+        queue->_local[i] = queue->_local[i + 1];
+    }
+}
+
+/* Passes an event delivered to the consumer to the observer of the Queue, if any (see queue_set_observer)
+ */
+static void queue_observe(Queue *queue, const Event *event) {
+    if (queue->_observer != NULL) {
+        queue->_observer(event, queue->_observer_ctx);
+    }
+}
+
+/* Gets and removes the next event from the Queue, copying it into event
+ * Must only be called by the consumer thread
  * This function assumes the Queue is not empty
- * The removed item is also deleted from memory
- * Return: the value of the QueueItem
+ */
+void queue_get_event(Queue *queue, Event *event) {
+    if (queue->_local_count > 0) {
+        queue_take_local(queue, event);
+        queue_observe(queue, event);
+        return;
+    }
+
+    size_t head = queue_consumer_next(queue, queue_now(queue));
+    *event = queue->_items[head & queue->_mask];
+    atomic_store_explicit(&queue->_head, head + 1, memory_order_release);
+    queue_observe(queue, event);
+}
+
+/* Gets and removes the next value from the Queue
+ * Same as queue_get_event, only returning the value of the event
+ * Return: the value
  */
 int queue_get(Queue *queue) {
-    pthread_mutex_lock(&queue->mutex);
-    QueueItem *tmp = queue->head;
-    int val = tmp->val;
-    // make the next item be the head
-    queue->head = tmp->next;
-    // if there was no next item, make tail also be NULL
-    if (queue->head == NULL) {
-        queue->tail = NULL;
+    Event event;
+    queue_get_event(queue, &event);
+    return event.value;
+}
+
+/* Calls f on every pending event of the Queue, in order, up to max events, removing them
+ * Only called by the consumer thread; the events placed with queue_put_local come first, then those of the ring buffer,
+ *  skipping the ones discarded by the policies of their values (see queue_set_policy), which don't count towards max;
+ *  every event is passed to the observer of the Queue before f (see queue_set_observer)
+ * The tail index of the producer is read once and the head index is published once, however many events are taken, so
+ *  the cost of synchronizing with the producer doesn't depend on the number of events; events put while f is running
+ *  are left for the next call, and the events are only removed (making room for the producer) once f has been called on
+ *  all of them
+ * Return: the number of events f was called on
+ */
+static size_t queue_take(Queue *queue, size_t max, void (*f)(const Event *event, void *ctx), void *ctx) {
+    size_t count = 0;
+    Event event;
+    while (queue->_local_count > 0 && count < max) {
+        queue_take_local(queue, &event);
+        queue_observe(queue, &event);
+        f(&event, ctx);
+        ++count;
+    }
+
+    long long now = queue_now(queue);
+    queue->_tail_cache = atomic_load_explicit(&queue->_tail, memory_order_acquire);
+    size_t tail = queue->_tail_cache;
+    size_t head = queue_consumer_next(queue, now);
+    for (; (ptrdiff_t)(tail - head) > 0 && count < max; ++head) {
+        const Event *pending = &queue->_items[head & queue->_mask];
+        if (!queue_skipped(queue, pending, now)) {
+            queue_observe(queue, pending);
+            f(pending, ctx);
+            ++count;
+        }
     }
-    pthread_mutex_unlock(&queue->mutex);
-    free(tmp);
-    return val;
+    atomic_store_explicit(&queue->_head, head, memory_order_release);
+    return count;
+}
+
+// array filled by queue_drain_events and queue_drain, passed through queue_take
+typedef struct {
+    Event *events;
+    int *values;
+    size_t count;
+} DrainBuffer;
+
+static void queue_copy_event(const Event *event, void *ctx) {
+    DrainBuffer *buffer = ctx;
+    buffer->events[buffer->count++] = *event;
+}
+
+static void queue_copy_value(const Event *event, void *ctx) {
+    DrainBuffer *buffer = ctx;
+    buffer->values[buffer->count++] = event->value;
 }
 
-/* Clears the Queue of all items contained within it
- * Deletes QueueItems contained in Queue from memory
- * THREAD SAFE
+/* Gets and removes every pending event from the Queue, up to max events, in a single step
+ * Must only be called by the consumer thread
+ * The tail index of the producer is read once and the head index is published once, however many events are taken, so
+ *  the cost of synchronizing with the producer doesn't depend on the number of events
+ * Events discarded by the policies of their values (see queue_set_policy) are skipped, and don't count towards max
+ * Event *buf: array of at least max events, into which the events are copied in order
+ * Return: the number of events copied into buf (0 if the Queue is empty)
+ */
+size_t queue_drain_events(Queue *queue, Event *buf, size_t max) {
+    DrainBuffer buffer = {buf, NULL, 0};
+    return queue_take(queue, max, queue_copy_event, &buffer);
+}
+
+/* Gets and removes every pending value from the Queue, up to max values, in a single step
+ * Same as queue_drain_events, only copying the values of the events
+ * int *buf: array of at least max values, into which the values are copied in order
+ * Return: the number of values copied into buf (0 if the Queue is empty)
+ */
+size_t queue_drain(Queue *queue, int *buf, size_t max) {
+    DrainBuffer buffer = {NULL, buf, 0};
+    return queue_take(queue, max, queue_copy_value, &buffer);
+}
+
+/* Calls f on every pending event of the Queue, in order, removing them
+ * Must only be called by the consumer thread
+ * Like queue_drain_events, events are taken in a single step: those put while f is running are left for the next call,
+ *  and the events are only removed from the Queue (making room for the producer) once f has been called on all of them
+ * void *ctx: passed to every call of f
+ * Return: the number of events f was called on
+ */
+size_t queue_for_each_event(Queue *queue, void (*f)(const Event *event, void *ctx), void *ctx) {
+    return queue_take(queue, SIZE_MAX, f, ctx);
+}
+
+// callback and context of queue_for_each_pending, passed through queue_for_each_event
+typedef struct {
+    void (*f)(int val, void *ctx);
+    void *ctx;
+} ValueCallback;
+
+static void queue_call_value(const Event *event, void *ctx) {
+    ValueCallback *callback = ctx;
+    callback->f(event->value, callback->ctx);
+}
+
+/* Calls f on the value of every pending event of the Queue, in order, removing them
+ * Same as queue_for_each_event, only passing the values of the events
+ * Return: the number of values f was called on
+ */
+size_t queue_for_each_pending(Queue *queue, void (*f)(int val, void *ctx), void *ctx) {
+    ValueCallback callback = {f, ctx};
+    return queue_for_each_event(queue, queue_call_value, &callback);
+}
+
+/* Clears the Queue of all values put into it so far
+ * Can be called by either thread: the values aren't removed here, but marked as discarded, and the consumer skips them
+ *  the next time it reads the Queue; values placed with queue_put_local are kept
  */
 void queue_clear(Queue *queue) {
-    pthread_mutex_lock(&queue->mutex);
-    QueueItem *curr = queue->head, *tmp;
-    while (curr != NULL) {
-        tmp = curr;
-        curr = curr->next;
-        free(tmp);
+    size_t tail = atomic_load_explicit(&queue->_tail, memory_order_acquire);
+    size_t discard = atomic_load_explicit(&queue->_discard, memory_order_relaxed);
+    while ((ptrdiff_t)(tail - discard) > 0 &&
+           !atomic_compare_exchange_weak_explicit(&queue->_discard, &discard, tail, memory_order_release,
+                                                  memory_order_relaxed));
+}
+
+/* Sets the policy of the key events (EVENT_KEY and EVENT_KEY_REPEAT) of a value, deciding which of them are delivered
+ *  to the consumer when several are pending
+ * Should be called before the KeyListener starts handling input (see keylistener_handle_in)
+ * int val: the value, from 0 to QUEUE_POLICIES - 1; values without a policy use QUEUE_POLICY_KEEP without a TTL
+ * int policy: one of the QUEUE_POLICY_ policies
+ * int group: for QUEUE_POLICY_LATEST, the group (0 to QUEUE_POLICY_GROUPS - 1) of values of which only the newest
+ *  pending event is delivered; e.g. the four arrow keys share a group, so only the last direction pressed is delivered
+ * long long ttl_ns: time after which a pending event is discarded instead of delivered, in nanoseconds, measured from
+ *  the time of the event; 0 for no TTL
+ */
+void queue_set_policy(Queue *queue, int val, int policy, int group, long long ttl_ns) {
+    if (val < 0 || val >= QUEUE_POLICIES) {
+        return;
+    }
+    EventPolicy *entry = &queue->_policies[val];
+    entry->policy = policy;
+    entry->group = group;
+    entry->ttl_ns = ttl_ns;
+    if (ttl_ns) {
+        queue->_ttl = 1;
     }
-    queue->head = NULL;
-    queue->tail = NULL;
-    pthread_mutex_unlock(&queue->mutex);
+}
+
+/* Sets a function called on every event delivered to the consumer, by any of the functions getting events from the
+ *  Queue, after the policies of the values are applied; used to record the events a game loop receives (see Recorder)
+ * Must be called before the consumer starts reading the Queue; f is called on the consumer thread, with ctx
+ * Passing NULL as f removes the observer
+ */
+void queue_set_observer(Queue *queue, void (*f)(const Event *event, void *ctx), void *ctx) {
+    queue->_observer = f;
+    queue->_observer_ctx = ctx;
+}
+
+/* Announces that the consumer is about to wait on the event file descriptor of the Queue (see queue_event_fd)
+ * Must only be called by the consumer thread; from this call until queue_disarm, every value put into the Queue signals
+ *  the event file descriptor, so polling it can't miss a value
+ * Return: 1 if the Queue already holds values, in which case the consumer shouldn't wait, else 0
+ */
+int queue_arm(Queue *queue) {
+    atomic_store_explicit(&queue->_waiting, 1, memory_order_relaxed);
+    // pairs with the fence of queue_put: either the value put is seen here, or the producer sees _waiting and signals
+    atomic_thread_fence(memory_order_seq_cst);
+    return !queue_empty(queue);
+}
+
+/* Ends a wait started by queue_arm
+ * Must only be called by the consumer thread; the event file descriptor is reset, so it is only readable again once a
+ *  value is put after the next call to queue_arm
+ */
+void queue_disarm(Queue *queue) {
+    atomic_store_explicit(&queue->_waiting, 0, memory_order_relaxed);
+    uint64_t count;
+    read(queue->_event_fd, &count, sizeof(count));
+}
+
+/* Gets the event file descriptor of the Queue, which becomes readable when a value is put into the Queue while the
+ *  consumer waits for one
+ * Lets the consumer wait on the Queue and other file descriptors (e.g. a timerfd for the next frame) in a single poll:
+ *  queue_arm must be called before polling (skipping the poll if it returns 1) and queue_disarm after it
+ * Return: the file descriptor; it is owned by the Queue, and closed by delete_queue
+ */
+int queue_event_fd(Queue *queue) {
+    return queue->_event_fd;
+}
+
+/* Blocks until the Queue holds a value, until the monotonic clock reaches the given deadline, or until the Queue is
+ *  finished (see queue_finish)
+ * Must only be called by the consumer thread; the thread sleeps in poll on the event and finish file descriptors of the
+ *  Queue, so no CPU time is used while waiting
+ * Waking up doesn't end the wait by itself: the event file descriptor can be signalled while the Queue is empty (e.g. by
+ *  a value put while the consumer was already reading the previous ones, or by values discarded by their policies, see
+ *  queue_set_policy), in which case the wait goes on until the deadline
+ * long long deadline: monotonic time in nanoseconds (see get_monotonic_ns); if negative, there is no deadline
+ * Return: 1 if the Queue holds a value, or 0 if the deadline passed or the Queue was finished first
+ */
+int queue_wait_until(Queue *queue, long long deadline) {
+    if (!queue_empty(queue)) {
+        return 1;
+    }
+
+    struct pollfd fds[2] = {
+        {queue->_event_fd, POLLIN, 0},
+        {queue->_finish_fd, POLLIN, 0},
+    };
+    while (!queue->finished) {
+        if (queue_arm(queue)) {
+            queue_disarm(queue);
+            return 1;
+        }
+        int timeout = -1;
+        if (deadline >= 0) {
+            long long remaining = deadline - get_monotonic_ns();
+            if (remaining <= 0) {
+                queue_disarm(queue);
+                break;
+            }
+            // round up, so the deadline has passed when poll times out
+            long long ms = (remaining + 999999) / 1000000;
+            timeout = ms > INT_MAX ? INT_MAX : (int)ms;
+        }
+        int ready = poll(fds, 2, timeout);
+        queue_disarm(queue);
+        if (!queue_empty(queue)) {
+            return 1;
+        }
+        if (ready == -1 && errno != EINTR) {
+            break;
+        }
+    }
+    return !queue_empty(queue);
+}
+
+/* Marks execution as finished, setting the finished flag and signalling the finish file descriptor of the Queue
+ * Can be called by either thread, any number of times; the Drawer calls it when the game loop function returns, so the
+ *  KeyListener wakes up and exits
+ */
+void queue_finish(Queue *queue) {
+    queue->finished = 1;
+    uint64_t one = 1;
+    write(queue->_finish_fd, &one, sizeof(one));
+}
+
+/* Gets the finish file descriptor of the Queue, an eventfd which becomes readable once queue_finish is called
+ * Return: the file descriptor; it is owned by the Queue, and closed by delete_queue
+ */
+int queue_finish_fd(Queue *queue) {
+    return queue->_finish_fd;
 }
 
 /* Gets the current UNIX timestamp
@@ -131,5 +588,23 @@ void get_timestamp(time_t *sec, long *msec) {
     }
 }
 
+/* Gets the current time of the monotonic clock in nanoseconds
+ * Unlike get_timestamp, the value is not affected by changes to the wall-clock time, so it should be used to measure
+ *  intervals and compute deadlines
+ */
+long long get_monotonic_ns() {
+    struct timespec spec;
+    clock_gettime(CLOCK_MONOTONIC, &spec);
 
+    return (long long)spec.tv_sec * 1000000000LL + spec.tv_nsec;
+}
 
+/* Sleeps until the monotonic clock reaches the given deadline, in nanoseconds (see get_monotonic_ns)
+ * Returns immediately if the deadline has already passed; sleeping is resumed if interrupted by a signal
+ */
+void sleep_until_ns(long long deadline) {
+    struct timespec spec;
+    spec.tv_sec = deadline / 1000000000LL;
+    spec.tv_nsec = deadline % 1000000000LL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL) == EINTR);
+}
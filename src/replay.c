@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../header/replay.h"
+#include "../header/rng.h"
+
+/* Writes an unsigned number as LEB128 (7 bits per byte, least significant first, high bit set on all but the last)
+ */
+static void write_varint(FILE *file, uint64_t value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    putc((int)value, file);
+}
+
+/* Reads an unsigned number written by write_varint
+ * Return: 0 if successful, or -1 if the file ended first
+ */
+static int read_varint(FILE *file, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = getc(file);
+        if (byte == EOF) {
+            return -1;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* Writes a record (see RecordingHeader) for an event delivered in the current frame
+ */
+static void recorder_write(Recorder *recorder, int value, uint16_t type, uint16_t modifiers, long long time_ns) {
+    long long elapsed = time_ns - recorder->_last_ns;
+    write_varint(recorder->file, recorder->frame - recorder->_last_frame);
+    write_varint(recorder->file, elapsed > 0 ? (uint64_t)elapsed : 0);
+    // zigzag encoding, so small negative values stay short
+    write_varint(recorder->file, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+    putc(type, recorder->file);
+    putc(modifiers, recorder->file);
+    recorder->_last_frame = recorder->frame;
+    if (elapsed > 0) {
+        recorder->_last_ns = time_ns;
+    }
+}
+
+/* Observer of the Queue (see queue_set_observer): records every event delivered to the game loop, except EVENT_RESIZE,
+ *  which recorder_frame records instead
+ */
+static void recorder_observe(const Event *event, void *ctx) {
+    Recorder *recorder = ctx;
+    if (event->type == EVENT_RESIZE) {
+        return;
+    }
+    recorder_write(recorder, event->value, event->type, event->modifiers, event->time_ns);
+    ++recorder->events;
+}
+
+/* Frame function of the Drawer (see drawer_on_frame): counts the frames published
+ * If the Displays were resized along with the frame (see drawer_draw_display), records an EVENT_RESIZE event with
+ *  their new size in the next frame, which is when the Drawer placed it in the Queue, however late the game loop reads it
+ */
+static void recorder_frame(void *ctx) {
+    Recorder *recorder = ctx;
+    Drawer *drawer = recorder->drawer;
+    ++recorder->frame;
+    if (drawer->_rows != recorder->_rows || drawer->_columns != recorder->_columns) {
+        recorder->_rows = drawer->_rows;
+        recorder->_columns = drawer->_columns;
+        recorder_write(recorder, recorder->_rows << 16 | recorder->_columns, EVENT_RESIZE, 0, get_monotonic_ns());
+        ++recorder->events;
+    }
+}
+
+/* Clock function of the Drawer (see drawer_on_clock): records the time the current frame advances the game by, as a
+ *  RECORD_CLOCK record
+ * Return: the time, unchanged
+ */
+static long long recorder_clock(long long elapsed_ns, void *ctx) {
+    Recorder *recorder = ctx;
+    if (elapsed_ns < 0) {
+        elapsed_ns = 0;
+    }
+    write_varint(recorder->file, recorder->frame - recorder->_last_frame);
+    write_varint(recorder->file, (uint64_t)elapsed_ns);
+    write_varint(recorder->file, 0);
+    putc(RECORD_CLOCK, recorder->file);
+    putc(0, recorder->file);
+    recorder->_last_frame = recorder->frame;
+    return elapsed_ns;
+}
+
+/* Initializes a Recorder, which records the events delivered to the game loop to the file at the given path
+ * Must be called before the drawer thread is started, and after the random number generator is seeded (see rng_seed),
+ *  since the seed is saved in the recording
+ * Return: Pointer to the initialized Recorder, or NULL if the file couldn't be created
+ */
+Recorder* init_recorder(const char *path, Drawer *drawer, Queue *queue) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+    RecordingHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.rows = drawer->_rows;
+    header.columns = drawer->_columns;
+    header.seed = rng_get_seed();
+    fwrite(&header, sizeof(header), 1, file);
+
+    Recorder *new = malloc(sizeof(Recorder));
+    new->file = file;
+    new->drawer = drawer;
+    new->frame = 0;
+    new->events = 0;
+    new->_last_frame = 0;
+    new->_start_ns = get_monotonic_ns();
+    new->_last_ns = new->_start_ns;
+    new->_rows = drawer->_rows;
+    new->_columns = drawer->_columns;
+    queue_set_observer(queue, recorder_observe, new);
+    drawer_on_frame(drawer, recorder_frame, new);
+    drawer_on_clock(drawer, recorder_clock, new);
+    return new;
+}
+
+/* Deletes a Recorder, ending the recording with the number of frames the game ran for, and closes its file
+ * Must only be called once the drawer thread has finished (e.g. once keylistener_handle_in returns), since the Drawer
+ *  and Queue keep calling the Recorder until then
+ */
+void delete_recorder(Recorder *recorder) {
+    // end marker: an EVENT_NONE record in the last frame
+    recorder_write(recorder, 0, EVENT_NONE, 0, get_monotonic_ns());
+    fclose(recorder->file);
+    free(recorder);
+}
+
+/* Reads the next record of the recording into the Replay
+ * Sets _has_next to 0 if the recording ended
+ */
+static void replay_read(Replay *replay) {
+    uint64_t frames, elapsed, value;
+    int type, modifiers;
+    if (read_varint(replay->file, &frames) || read_varint(replay->file, &elapsed) ||
+        read_varint(replay->file, &value) || (type = getc(replay->file)) == EOF ||
+        (modifiers = getc(replay->file)) == EOF) {
+        replay->_has_next = 0;
+        return;
+    }
+    replay->_has_next = 1;
+    replay->_next_frame += frames;
+    replay->_next.time_ns = (long long)elapsed;
+    replay->_next.value = (int)((uint32_t)(value >> 1) ^ (0 - (uint32_t)(value & 1)));
+    replay->_next.type = (uint16_t)type;
+    replay->_next.modifiers = (uint16_t)modifiers;
+}
+
+/* Places the events of the current frame in the Queue
+ * This runs on the drawer thread, the consumer of the Queue, so events are put with queue_put_direct: waiting for room
+ *  would never end, and the events were recorded after the policies of their values were applied, so they must not be
+ *  coalesced or expire again; events are timestamped with the time they are placed at
+ * The Displays are resized to the size recorded with an EVENT_RESIZE event before it is placed (see drawer_resize), as
+ *  the Drawer would when the terminal is resized
+ * The recorded time the frame advances the game by, if any, is kept for replay_clock
+ * Once the frame after the end of the recording is reached, EVENT_QUIT is placed in the Queue, in case the game loop is
+ *  still running
+ */
+static void replay_feed(Replay *replay) {
+    long long now = get_monotonic_ns();
+    while (replay->_has_next && replay->_next_frame <= replay->frame && replay->_next.type != EVENT_NONE) {
+        if (replay->_next.type == RECORD_CLOCK) {
+            replay->_clock_ns = replay->_next.time_ns;
+            replay_read(replay);
+            continue;
+        }
+        Event event = replay->_next;
+        event.time_ns = now;
+        if (event.type == EVENT_RESIZE) {
+            int rows = event.value >> 16;
+            int columns = event.value & 0xffff;
+            if (rows > 0 && columns > 0) {
+                drawer_resize(replay->drawer, rows, columns);
+            }
+            event.value = RESIZE_EVENT;
+        }
+        queue_put_direct(replay->queue, &event);
+        ++replay->events;
+        replay_read(replay);
+    }
+    // the game loop ended by itself in the frame of the end marker, so it only needs to be stopped after that frame, or
+    //  right away if the recording was cut short
+    if (!replay->_ended && (!replay->_has_next || replay->_next_frame < replay->frame)) {
+        Event event = {now, 0, EVENT_QUIT, 0};
+        queue_put_direct(replay->queue, &event);
+        replay->_ended = 1;
+    }
+}
+
+/* Frame function of the Drawer (see drawer_on_frame): places the events of the next frame in the Queue
+ */
+static void replay_frame(void *ctx) {
+    Replay *replay = ctx;
+    ++replay->frame;
+    replay_feed(replay);
+}
+
+/* Clock function of the Drawer (see drawer_on_clock): replaces the time the current frame advances the game by with
+ *  the recorded one, read by replay_feed along with the events of the frame
+ * Return: the recorded time, or the given one if the frame has none (e.g. the recording ended)
+ */
+static long long replay_clock(long long elapsed_ns, void *ctx) {
+    Replay *replay = ctx;
+    if (replay->_clock_ns < 0) {
+        return elapsed_ns;
+    }
+    long long clock = replay->_clock_ns;
+    replay->_clock_ns = -1;
+    return clock;
+}
+
+/* Initializes a Replay of the recording file at the given path
+ * The random number generator is seeded with the seed of the recording (see rng_seed), and the Displays of the Drawer
+ *  are given the size of the recording when it started (see drawer_set_size), so this must be called before the drawer
+ *  thread is started; the game loop must draw its random numbers from rng_next or rng_range, and read its input from the Queue
+ *  only (not from an InputState), for the replay to be exact
+ * If the Drawer still presents to the terminal, it is given a null backend instead; any other backend set beforehand is
+ *  kept, e.g. a memory backend to check the frames of the replay
+ * The events of the first frame are placed in the Queue right away
+ * int mode: REPLAY_REALTIME or REPLAY_FAST
+ * Return: Pointer to the initialized Replay, or NULL if the file couldn't be opened or isn't a recording
+ */
+Replay* init_replay(const char *path, Drawer *drawer, Queue *queue, int mode) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    RecordingHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) ||
+        header.version < 1 || header.version > RECORDING_VERSION || header.rows <= 0 || header.columns <= 0) {
+        fclose(file);
+        return NULL;
+    }
+
+    rng_seed(header.seed);
+    Backend *backend = NULL;
+    if (drawer->backend->type == BACKEND_TERMINAL) {
+        backend = init_null_backend();
+        drawer_set_backend(drawer, backend);
+    }
+    drawer_set_size(drawer, header.rows, header.columns);
+    if (mode == REPLAY_FAST) {
+        drawer->paced = 0;
+    }
+
+    Replay *new = malloc(sizeof(Replay));
+    new->file = file;
+    new->drawer = drawer;
+    new->queue = queue;
+    new->mode = mode;
+    new->frame = 0;
+    new->events = 0;
+    new->elapsed_ns = 0;
+    new->_has_next = 0;
+    new->_next_frame = 0;
+    new->_clock_ns = -1;
+    new->_ended = 0;
+    new->_start_ns = get_monotonic_ns();
+    new->_backend = backend;
+    drawer_on_frame(drawer, replay_frame, new);
+    drawer_on_clock(drawer, replay_clock, new);
+    replay_read(new);
+    replay_feed(new);
+    return new;
+}
+
+/* Deletes a Replay, along with the null backend it set, if any, and closes its file
+ * Must be called after the Drawer is deleted (see replay_run)
+ */
+void delete_replay(Replay *replay) {
+    fclose(replay->file);
+    if (replay->_backend != NULL) {
+        delete_backend(replay->_backend);
+    }
+    free(replay);
+}
+
+/* Runs a Replay, in place of keylistener_handle_in
+ * This must be run on the main thread once the drawer thread is started, and blocks until the game loop function
+ *  returns; the Drawer and the Queue are then deleted, as keylistener_handle_in would, while the Replay is kept so its
+ *  measurements (frame, events, elapsed_ns) can be read
+ */
+void replay_run(Replay *replay) {
+    Drawer *drawer = replay->drawer;
+    if (drawer->thread_id != NULL) {
+        pthread_join(*drawer->thread_id, NULL);
+    }
+    else {
+        printf("Warning: Replay was run, but drawer thread hasn't started\n");
+    }
+    replay->elapsed_ns = get_monotonic_ns() - replay->_start_ns;
+    delete_drawer(drawer);
+    delete_queue(replay->queue);
+    replay->drawer = NULL;
+    replay->queue = NULL;
+}
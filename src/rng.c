@@ -0,0 +1,49 @@
+#include "../header/rng.h"
+
+// seed the generator was last seeded with
+static uint64_t seed_value = 1;
+// state of the generator; never 0 once seeded
+static uint64_t state = 0;
+
+/* Seeds the random number generator, so the numbers it returns from now on only depend on the seed
+ * Any seed is valid, including 0
+ */
+void rng_seed(uint64_t seed) {
+    seed_value = seed;
+    // scramble the seed (splitmix64), so close seeds give unrelated sequences and the state is never 0
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    state = z ? z : 0x9e3779b97f4a7c15ULL;
+}
+
+/* Gets the seed the random number generator was last seeded with (1 if rng_seed was never called)
+ */
+uint64_t rng_get_seed() {
+    return seed_value;
+}
+
+/* Gets the next random number
+ * If the generator was never seeded, it is seeded with 1 first, so the sequence matches rng_get_seed
+ * Return: a uniformly distributed 32-bit number
+ */
+uint32_t rng_next() {
+    if (state == 0) {
+        rng_seed(seed_value);
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+/* Gets a random number in the range [0, n)
+ * Return: the number, or 0 if n isn't positive
+ */
+int rng_range(int n) {
+    if (n <= 0) {
+        return 0;
+    }
+    return (int)(((uint64_t)rng_next() * (uint32_t)n) >> 32);
+}